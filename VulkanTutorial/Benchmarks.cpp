@@ -0,0 +1,475 @@
+﻿#include "Benchmarks.h"
+
+#include "DeviceMemoryAllocator.h"
+#include "ObjLoader.h"
+#include "ThreadPool.h"
+#include "VertexDeduplicator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+	using BenchmarkFunc = std::function<void(const std::vector<std::string>&)>;
+
+	class Timer
+	{
+	public:
+		Timer() : start(std::chrono::high_resolution_clock::now()) {}
+
+		double elapsedMs() const
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+	private:
+		std::chrono::high_resolution_clock::time_point start;
+	};
+
+	size_t argAsSize(const std::vector<std::string>& _args, size_t _index, size_t _default)
+	{
+		if (_index < _args.size())
+			return static_cast<size_t>(std::stoull(_args[_index]));
+
+		return _default;
+	}
+
+	// _gridSize x _gridSize vertices, 2 triangles per cell, every record type loadModel() reads
+	void writeGridObj(const std::string& _path, size_t _gridSize)
+	{
+		std::ofstream file(_path, std::ios::binary);
+		if (file.is_open() == false)
+			throw std::runtime_error("failed to create benchmark obj file!");
+
+		std::vector<char> buffer(1 << 20);
+		file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+
+		const float step = 1.0f / static_cast<float>(_gridSize - 1);
+
+		file << std::fixed << std::setprecision(6) << "o benchmark_grid\n";
+
+		for (size_t y = 0; y < _gridSize; y++)
+		{
+			for (size_t x = 0; x < _gridSize; x++)
+				file << "v " << x * step << ' ' << y * step << " 0.000000\n";
+		}
+
+		for (size_t y = 0; y < _gridSize; y++)
+		{
+			for (size_t x = 0; x < _gridSize; x++)
+				file << "vt " << x * step << ' ' << y * step << '\n';
+		}
+
+		file << "vn 0.0000 0.0000 1.0000\n";
+
+		for (size_t y = 0; y + 1 < _gridSize; y++)
+		{
+			for (size_t x = 0; x + 1 < _gridSize; x++)
+			{
+				size_t i0 = y * _gridSize + x + 1;
+				size_t i1 = i0 + 1;
+				size_t i2 = i0 + _gridSize;
+				size_t i3 = i2 + 1;
+
+				file << "f " << i0 << '/' << i0 << "/1 " << i1 << '/' << i1 << "/1 " << i3 << '/' << i3 << "/1\n";
+				file << "f " << i0 << '/' << i0 << "/1 " << i3 << '/' << i3 << "/1 " << i2 << '/' << i2 << "/1\n";
+			}
+		}
+	}
+
+	bool sameIndex(const tinyobj::index_t& _a, const tinyobj::index_t& _b)
+	{
+		return _a.vertex_index == _b.vertex_index && _a.texcoord_index == _b.texcoord_index && _a.normal_index == _b.normal_index;
+	}
+
+	// what loadModel() reads : the attributes and the triangulated indices of every shape
+	bool sameObjData(const tinyobj::attrib_t& _attribA, const std::vector<tinyobj::shape_t>& _shapesA, const tinyobj::attrib_t& _attribB, const std::vector<tinyobj::shape_t>& _shapesB)
+	{
+		if (_attribA.vertices != _attribB.vertices || _attribA.texcoords != _attribB.texcoords || _attribA.normals != _attribB.normals)
+			return false;
+
+		if (_shapesA.size() != _shapesB.size())
+			return false;
+
+		for (size_t i = 0; i < _shapesA.size(); i++)
+		{
+			const std::vector<tinyobj::index_t>& indicesA = _shapesA[i].mesh.indices;
+			const std::vector<tinyobj::index_t>& indicesB = _shapesB[i].mesh.indices;
+
+			if (_shapesA[i].name != _shapesB[i].name || indicesA.size() != indicesB.size())
+				return false;
+
+			if (std::equal(indicesA.begin(), indicesA.end(), indicesB.begin(), sameIndex) == false)
+				return false;
+		}
+
+		return true;
+	}
+
+	// args : [grid size = 1500] [max threads = hardware threads]
+	void benchmarkObjParsing(const std::vector<std::string>& _args)
+	{
+		const size_t gridSize = std::max<size_t>(argAsSize(_args, 0, 1500), 2);
+		const uint32_t maxThreads = static_cast<uint32_t>(argAsSize(_args, 1, std::max(1u, std::thread::hardware_concurrency())));
+		const std::string path = "benchmark_grid.obj";
+
+		std::cout << "generating " << gridSize << "x" << gridSize << " grid obj..." << std::endl;
+		writeGridObj(path, gridSize);
+
+		std::ifstream sizeCheck(path, std::ios::ate | std::ios::binary);
+		double fileMb = static_cast<double>(sizeCheck.tellg()) / (1024.0 * 1024.0);
+		sizeCheck.close();
+
+		std::cout << "file size : " << fileMb << " MB\n" << std::endl;
+		std::cout << std::fixed << std::setprecision(1);
+
+		// kept to check every LoadObjParallel run against
+		tinyobj::attrib_t baselineAttrib;
+		std::vector<tinyobj::shape_t> baselineShapes;
+		double baselineMs = 0.0;
+		{
+			std::vector<tinyobj::material_t> materials;
+			std::string warn, err;
+
+			Timer timer;
+			if (tinyobj::LoadObj(&baselineAttrib, &baselineShapes, &materials, &warn, &err, path.c_str()) == false)
+				throw std::runtime_error(warn + err);
+			baselineMs = timer.elapsedMs();
+
+			std::cout << std::left << std::setw(24) << "tinyobj::LoadObj" << std::right << std::setw(11) << baselineMs << " ms"
+				<< std::setw(11) << fileMb * 1000.0 / baselineMs << " MB/s" << std::endl;
+		}
+
+		// 1, 2, 4, ... and finally maxThreads
+		std::vector<uint32_t> threadCounts;
+		for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+			threadCounts.push_back(threads);
+		threadCounts.push_back(std::max(maxThreads, 1u));
+
+		double singleThreadMs = 0.0;
+		for (uint32_t threads : threadCounts)
+		{
+			ThreadPool threadPool(threads);
+
+			tinyobj::attrib_t attrib;
+			std::vector<tinyobj::shape_t> shapes;
+			std::string warn, err;
+
+			Timer timer;
+			if (LoadObjParallel(&attrib, &shapes, &warn, &err, path.c_str(), threadPool) == false)
+				throw std::runtime_error(warn + err);
+			double ms = timer.elapsedMs();
+
+			if (sameObjData(baselineAttrib, baselineShapes, attrib, shapes) == false)
+				throw std::runtime_error("LoadObjParallel results differ from tinyobj::LoadObj!");
+
+			if (threads == 1)
+				singleThreadMs = ms;
+
+			std::cout << std::left << std::setw(24) << "LoadObjParallel x" + std::to_string(threads) << std::right << std::setw(11) << ms << " ms"
+				<< std::setw(11) << fileMb * 1000.0 / ms << " MB/s" << std::setprecision(2)
+				<< "   scaling " << std::setw(5) << singleThreadMs / ms << "x   vs tinyobj " << std::setw(5) << baselineMs / ms << "x" << std::setprecision(1) << std::endl;
+		}
+
+		std::remove(path.c_str());
+	}
+
+	// obj indices of corner _corner of a triangulated _gridSize x _gridSize grid, laid out like loadModel() sees it
+	tinyobj::index_t gridCornerIndex(size_t _corner, size_t _gridSize)
+	{
+		static const size_t cornerOffsets[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+
+		const size_t cellsPerRow = _gridSize - 1;
+		const size_t cell = (_corner / 6) % (cellsPerRow * cellsPerRow);
+		const size_t x = cell % cellsPerRow + cornerOffsets[_corner % 6][0];
+		const size_t y = cell / cellsPerRow + cornerOffsets[_corner % 6][1];
+
+		tinyobj::index_t index;
+		index.vertex_index = static_cast<int>(y * _gridSize + x);
+		index.texcoord_index = index.vertex_index;
+		index.normal_index = 0;
+
+		return index;
+	}
+
+	// the positions / texcoords writeGridObj() writes
+	void buildGridAttrib(tinyobj::attrib_t& _attrib, size_t _gridSize)
+	{
+		const float step = 1.0f / static_cast<float>(_gridSize - 1);
+
+		_attrib.vertices.clear();
+		_attrib.texcoords.clear();
+
+		for (size_t y = 0; y < _gridSize; y++)
+		{
+			for (size_t x = 0; x < _gridSize; x++)
+			{
+				_attrib.vertices.insert(_attrib.vertices.end(), { x * step, y * step, 0.0f });
+				_attrib.texcoords.insert(_attrib.texcoords.end(), { x * step, y * step });
+			}
+		}
+	}
+
+	// same gather as loadModel()
+	Vertex attribVertex(const tinyobj::attrib_t& _attrib, const tinyobj::index_t& _index)
+	{
+		Vertex vertex{};
+		vertex.pos = { _attrib.vertices[3 * _index.vertex_index + 0], _attrib.vertices[3 * _index.vertex_index + 1], _attrib.vertices[3 * _index.vertex_index + 2] };
+		vertex.texCoord = { _attrib.texcoords[2 * _index.texcoord_index + 0], 1.0f - _attrib.texcoords[2 * _index.texcoord_index + 1] };
+		vertex.color = { 1.0f, 1.0f, 1.0f };
+
+		return vertex;
+	}
+
+	// args : [max corner count = 50000000]
+	void benchmarkVertexDeduplication(const std::vector<std::string>& _args)
+	{
+		const size_t maxCorners = std::max<size_t>(argAsSize(_args, 0, 50000000), 6);
+
+		std::vector<size_t> cornerCounts;
+		for (size_t corners = 100000; corners < maxCorners; corners *= 10)
+			cornerCounts.push_back(corners);
+		cornerCounts.push_back(maxCorners);
+
+		for (size_t cornerCount : cornerCounts)
+		{
+			// enough cells that every corner belongs to a distinct triangle
+			size_t gridSize = 2;
+			while ((gridSize - 1) * (gridSize - 1) * 6 < cornerCount)
+				gridSize++;
+
+			tinyobj::attrib_t attrib;
+			buildGridAttrib(attrib, gridSize);
+
+			std::vector<Vertex> mapVertices;
+			std::vector<uint32_t> mapIndices;
+			double mapMs = 0.0;
+			{
+				// the loop loadModel() used to run
+				std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+
+				Timer timer;
+				for (size_t i = 0; i < cornerCount; i++)
+				{
+					Vertex vertex = attribVertex(attrib, gridCornerIndex(i, gridSize));
+
+					if (uniqueVertices.count(vertex) == 0)
+					{
+						uniqueVertices[vertex] = static_cast<uint32_t>(mapVertices.size());
+						mapVertices.push_back(vertex);
+					}
+
+					mapIndices.push_back(uniqueVertices[vertex]);
+				}
+				mapMs = timer.elapsedMs();
+			}
+
+			std::vector<Vertex> flatVertices;
+			std::vector<uint32_t> flatIndices;
+			double flatMs = 0.0;
+			{
+				Timer timer;
+				VertexDeduplicator uniqueVertices(flatVertices, cornerCount / 4);
+				flatIndices.reserve(cornerCount);
+
+				for (size_t i = 0; i < cornerCount; i++)
+					flatIndices.push_back(uniqueVertices.insert(attribVertex(attrib, gridCornerIndex(i, gridSize))));
+				flatMs = timer.elapsedMs();
+			}
+
+			std::vector<Vertex> indexVertices;
+			std::vector<uint32_t> indexIndices;
+			double indexMs = 0.0;
+			{
+				Timer timer;
+				IndexDeduplicator uniqueCorners(attrib.vertices.size() / 3, cornerCount / 4);
+				VertexDeduplicator uniqueVertices(indexVertices, cornerCount / 4);
+				std::vector<uint32_t> cornerVertices;
+				cornerVertices.reserve(cornerCount / 4);
+				indexIndices.reserve(cornerCount);
+
+				for (size_t i = 0; i < cornerCount; i++)
+				{
+					tinyobj::index_t index = gridCornerIndex(i, gridSize);
+
+					bool isNew = false;
+					uint32_t key = uniqueCorners.insert(index, isNew);
+
+					if (isNew == true)
+						cornerVertices.push_back(uniqueVertices.insert(attribVertex(attrib, index)));
+
+					indexIndices.push_back(cornerVertices[key]);
+				}
+				indexMs = timer.elapsedMs();
+			}
+
+			if (mapIndices != flatIndices || mapVertices.size() != flatVertices.size() ||
+				mapIndices != indexIndices || mapVertices.size() != indexVertices.size())
+				throw std::runtime_error("vertex deduplication results differ!");
+
+			std::cout << std::fixed << std::setw(10) << cornerCount << " corners " << std::setw(9) << flatVertices.size() << " unique   "
+				<< std::setprecision(1) << "unordered_map " << std::setw(9) << mapMs << " ms   "
+				<< "VertexDeduplicator " << std::setw(9) << flatMs << " ms (" << std::setprecision(2) << std::setw(5) << mapMs / flatMs << "x)   "
+				<< std::setprecision(1) << "IndexDeduplicator " << std::setw(9) << indexMs << " ms (" << std::setprecision(2) << std::setw(5) << mapMs / indexMs << "x)" << std::endl;
+		}
+	}
+
+	// args : [allocation count = 500000] [max live allocations = 20000] [bufferImageGranularity = 1024]
+	void benchmarkDeviceMemory(const std::vector<std::string>& _args)
+	{
+		const size_t allocationCount = std::max<size_t>(argAsSize(_args, 0, 500000), 1);
+		const size_t maxLive = std::max<size_t>(argAsSize(_args, 1, 20000), 1);
+		const VkDeviceSize granularity = argAsSize(_args, 2, 1024);
+
+		// a discrete GPU : large device local heap, small host visible device local one, system memory
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		memoryProperties.memoryHeapCount = 3;
+		memoryProperties.memoryHeaps[0].size = VkDeviceSize(8) * 1024 * 1024 * 1024;
+		memoryProperties.memoryHeaps[1].size = VkDeviceSize(256) * 1024 * 1024;
+		memoryProperties.memoryHeaps[2].size = VkDeviceSize(16) * 1024 * 1024 * 1024;
+		memoryProperties.memoryTypeCount = 3;
+		memoryProperties.memoryTypes[0] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+		memoryProperties.memoryTypes[1] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1 };
+		memoryProperties.memoryTypes[2] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 2 };
+
+		// no device : blocks are bookkeeping only, this times the suballocation itself
+		DeviceMemoryAllocator allocator;
+		allocator.create(VK_NULL_HANDLE, memoryProperties, granularity);
+
+		struct Request
+		{
+			VkMemoryRequirements requirements;
+			uint32_t memoryType;
+			bool optimalImage;
+		};
+
+		// mostly small buffers (uniforms, meshes), some textures, a few render targets large enough to be dedicated
+		std::mt19937_64 random(42);
+		std::vector<Request> requests(allocationCount);
+		for (Request& request : requests)
+		{
+			const uint32_t kind = static_cast<uint32_t>(random() % 1000);
+			if (kind < 800)
+			{
+				request.requirements.size = 256 + random() % (64 * 1024);
+				request.requirements.alignment = 256;
+				request.memoryType = (kind < 100) ? 1 : ((kind < 200) ? 2 : 0);
+				request.optimalImage = false;
+			}
+			else if (kind < 999)
+			{
+				request.requirements.size = 64 * 1024 * (1 + random() % 16);
+				request.requirements.alignment = 64 * 1024;
+				request.memoryType = 0;
+				request.optimalImage = true;
+			}
+			else
+			{
+				request.requirements.size = 1024 * 1024 * (33 + random() % 32);
+				request.requirements.alignment = 64 * 1024;
+				request.memoryType = 0;
+				request.optimalImage = true;
+			}
+
+			request.requirements.memoryTypeBits = 1u << request.memoryType;
+		}
+
+		std::vector<size_t> freeOrder(allocationCount);
+		for (size_t& index : freeOrder)
+			index = static_cast<size_t>(random());
+
+		std::vector<DeviceAllocation> live;
+		live.reserve(maxLive);
+
+		DeviceMemoryStats peak;
+		double allocateMs = 0.0;
+		double freeMs = 0.0;
+
+		// allocate until maxLive resources are alive, then free a random one before each allocation
+		Timer total;
+		for (size_t i = 0; i < allocationCount; i++)
+		{
+			if (live.size() == maxLive)
+			{
+				const size_t index = freeOrder[i] % live.size();
+
+				Timer timer;
+				allocator.free(live[index]);
+				freeMs += timer.elapsedMs();
+
+				live[index] = live.back();
+				live.pop_back();
+			}
+
+			Timer timer;
+			live.push_back(allocator.allocate(requests[i].requirements, requests[i].memoryType, requests[i].optimalImage));
+			allocateMs += timer.elapsedMs();
+
+			if (allocator.getStats().blockBytes + allocator.getStats().dedicatedBytes > peak.blockBytes + peak.dedicatedBytes)
+				peak = allocator.getStats();
+		}
+
+		const double loopMs = total.elapsedMs();
+		const size_t freeCount = allocationCount - live.size();
+
+		Timer timer;
+		for (DeviceAllocation& allocation : live)
+			allocator.free(allocation);
+		freeMs += timer.elapsedMs();
+
+		const DeviceMemoryStats& stats = allocator.getStats();
+		if (stats.allocationCount != 0 || stats.requestedBytes != 0 || stats.usedBytes != 0 || stats.dedicatedCount != 0)
+			throw std::runtime_error("device memory allocator leaked allocations!");
+
+		const double mb = 1024.0 * 1024.0;
+		std::cout << std::fixed << std::setprecision(1);
+		std::cout << allocationCount << " allocations, " << freeCount + live.size() << " frees, at most " << maxLive << " alive, bufferImageGranularity " << granularity << std::endl;
+		std::cout << "allocate " << std::setw(8) << allocateMs * 1e6 / allocationCount << " ns   free " << std::setw(8) << freeMs * 1e6 / allocationCount << " ns   (loop " << loopMs << " ms)" << std::endl;
+		std::cout << "vkAllocateMemory calls : " << stats.deviceAllocationCount << " instead of " << allocationCount << std::endl;
+		std::cout << "at peak : " << peak.blockCount << " blocks " << peak.blockBytes / mb << " MB + " << peak.dedicatedCount << " dedicated " << peak.dedicatedBytes / mb
+			<< " MB for " << peak.allocationCount << " allocations of " << peak.requestedBytes / mb << " MB (" << peak.usedBytes / mb << " MB after rounding)" << std::endl;
+		std::cout << "utilization at peak : " << 100.0 * peak.requestedBytes / (peak.blockBytes + peak.dedicatedBytes) << " % of reserved, "
+			<< 100.0 * peak.requestedBytes / peak.usedBytes << " % of rounded" << std::endl;
+
+		allocator.destroy();
+	}
+
+	const std::map<std::string, BenchmarkFunc>& getBenchmarks()
+	{
+		static const std::map<std::string, BenchmarkFunc> benchmarks = {
+			{ "device-memory", benchmarkDeviceMemory },
+			{ "obj-parse", benchmarkObjParsing },
+			{ "vertex-dedup", benchmarkVertexDeduplication },
+		};
+
+		return benchmarks;
+	}
+}
+
+bool RunBenchmark(const std::string& _name, const std::vector<std::string>& _args)
+{
+	const auto& benchmarks = getBenchmarks();
+
+	auto it = benchmarks.find(_name);
+	if (it == benchmarks.end())
+	{
+		std::cerr << "unknown benchmark '" << _name << "', available benchmarks :\n";
+		for (const auto& benchmark : benchmarks)
+			std::cerr << '\t' << benchmark.first << '\n';
+
+		return false;
+	}
+
+	it->second(_args);
+	return true;
+}
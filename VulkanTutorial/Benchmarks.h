@@ -0,0 +1,7 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+
+// Command line benchmarks : VulkanTutorial.exe --bench <name> [args...]
+// Prints the list of benchmarks and returns false if _name is unknown.
+bool RunBenchmark(const std::string& _name, const std::vector<std::string>& _args);
@@ -0,0 +1,78 @@
+﻿#include "CompactVertex.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	uint16_t quantizeUnorm16(float _value)
+	{
+		return static_cast<uint16_t>(std::lround(std::min(std::max(_value, 0.0f), 1.0f) * 65535.0f));
+	}
+
+	uint8_t quantizeUnorm8(float _value)
+	{
+		return static_cast<uint8_t>(std::lround(std::min(std::max(_value, 0.0f), 1.0f) * 255.0f));
+	}
+}
+
+glm::mat4 VertexQuantization::getDequantizeMatrix() const
+{
+	return glm::scale(glm::translate(glm::mat4(1.0f), positionMin), positionExtent);
+}
+
+VertexQuantization ComputeVertexQuantization(const Vertex* _vertices, size_t _vertexCount)
+{
+	VertexQuantization quantization;
+	if (_vertexCount == 0)
+		return quantization;
+
+	glm::vec3 minimum(FLT_MAX);
+	glm::vec3 maximum(-FLT_MAX);
+
+	for (size_t i = 0; i < _vertexCount; i++)
+	{
+		minimum = glm::min(minimum, _vertices[i].pos);
+		maximum = glm::max(maximum, _vertices[i].pos);
+
+		const glm::vec2& texCoord = _vertices[i].texCoord;
+		if (texCoord.x < 0.0f || texCoord.x > 1.0f || texCoord.y < 0.0f || texCoord.y > 1.0f)
+			quantization.texCoordsInUnitRange = false;
+	}
+
+	quantization.positionMin = minimum;
+	quantization.positionExtent = maximum - minimum;
+
+	return quantization;
+}
+
+void QuantizeVertices(const Vertex* _vertices, size_t _vertexCount, const VertexQuantization& _quantization, CompactVertex* _output)
+{
+	// flat axes (extent 0) quantize to 0, which the dequantize matrix maps back to positionMin
+	glm::vec3 inverseExtent(0.0f);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (_quantization.positionExtent[axis] > 0.0f)
+			inverseExtent[axis] = 1.0f / _quantization.positionExtent[axis];
+	}
+
+	for (size_t i = 0; i < _vertexCount; i++)
+	{
+		const Vertex& vertex = _vertices[i];
+		CompactVertex& compact = _output[i];
+
+		for (int axis = 0; axis < 3; axis++)
+			compact.pos[axis] = quantizeUnorm16((vertex.pos[axis] - _quantization.positionMin[axis]) * inverseExtent[axis]);
+		compact.pos[3] = 0;
+
+		for (int channel = 0; channel < 3; channel++)
+			compact.color[channel] = quantizeUnorm8(vertex.color[channel]);
+		compact.color[3] = 255;
+
+		compact.texCoord[0] = quantizeUnorm16(vertex.texCoord.x);
+		compact.texCoord[1] = quantizeUnorm16(vertex.texCoord.y);
+	}
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+
+// 16 byte quantized Vertex, read by the same vertex shader as Vertex (the formats unpack to floats) :
+//	pos			- 16 bit unorm relative to the mesh bounds, VertexQuantization::getDequantizeMatrix() maps it back
+//	color		- rgba8 unorm
+//	texCoord	- 16 bit unorm, needs texture coordinates in [0, 1]
+struct CompactVertex
+{
+	uint16_t pos[4]; // w is padding, 3 component 16 bit formats are rarely supported for vertex input
+	uint8_t color[4];
+	uint16_t texCoord[2];
+
+	static VkVertexInputBindingDescription getBindingDescription()
+	{
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(CompactVertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	// same locations as Vertex::getAttributeDescriptions()
+	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+		attributeDescriptions[0].offset = offsetof(CompactVertex, pos);
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+		attributeDescriptions[1].offset = offsetof(CompactVertex, color);
+
+		attributeDescriptions[2].binding = 0;
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].format = VK_FORMAT_R16G16_UNORM;
+		attributeDescriptions[2].offset = offsetof(CompactVertex, texCoord);
+
+		return attributeDescriptions;
+	}
+};
+
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex must stay tightly packed");
+
+// Mesh bounds the positions are quantized against.
+struct VertexQuantization
+{
+	glm::vec3 positionMin = glm::vec3(0.0f);
+	glm::vec3 positionExtent = glm::vec3(0.0f);
+
+	bool texCoordsInUnitRange = true; // false : CompactVertex can't represent the mesh
+
+	// model space from the [0, 1] positions the shader sees, to be multiplied into the model matrix
+	glm::mat4 getDequantizeMatrix() const;
+};
+
+VertexQuantization ComputeVertexQuantization(const Vertex* _vertices, size_t _vertexCount);
+
+void QuantizeVertices(const Vertex* _vertices, size_t _vertexCount, const VertexQuantization& _quantization, CompactVertex* _output);
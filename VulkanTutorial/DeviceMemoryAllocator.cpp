@@ -0,0 +1,346 @@
+﻿#include "DeviceMemoryAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	uint32_t log2Floor(uint64_t _value)
+	{
+		uint32_t log = 0;
+		while (_value > 1)
+		{
+			_value >>= 1;
+			log++;
+		}
+
+		return log;
+	}
+
+	uint32_t lowestBit(uint64_t _mask)
+	{
+		uint32_t bit = 0;
+		while ((_mask & 1) == 0)
+		{
+			_mask >>= 1;
+			bit++;
+		}
+
+		return bit;
+	}
+}
+
+void BuddyAllocator::reset(uint64_t _size)
+{
+	size = _size;
+	levelCount = log2Floor(size / MIN_NODE_SIZE) + 1;
+
+	const size_t unitCount = static_cast<size_t>(size / MIN_NODE_SIZE);
+
+	freeHeads.assign(levelCount, NO_NODE);
+	freeLevelMask = 0;
+	nextFree.assign(unitCount, NO_NODE);
+	previousFree.assign(unitCount, NO_NODE);
+	freeLevels.assign(unitCount, NO_LEVEL);
+	allocatedLevels.assign(unitCount, NO_LEVEL);
+
+	usedSize = 0;
+	allocationCount = 0;
+
+	// one free node covering everything
+	pushFree(0, levelCount - 1);
+}
+
+bool BuddyAllocator::allocate(uint64_t _size, uint64_t _alignment, uint64_t& _offset)
+{
+	const uint64_t nodeSize = getNodeSize(_size, _alignment);
+	if (nodeSize > size)
+		return false;
+
+	const uint32_t level = log2Floor(nodeSize / MIN_NODE_SIZE);
+
+	// smallest free node that fits
+	const uint64_t candidates = freeLevelMask & ~((uint64_t(1) << level) - 1);
+	if (candidates == 0)
+		return false;
+
+	uint32_t freeLevel = lowestBit(candidates);
+	const uint32_t unit = freeHeads[freeLevel];
+	removeFree(unit, freeLevel);
+
+	// split down, keeping the lower half and freeing the upper ones
+	while (freeLevel > level)
+	{
+		freeLevel--;
+		pushFree(unit + (1u << freeLevel), freeLevel);
+	}
+
+	allocatedLevels[unit] = static_cast<uint8_t>(level);
+	usedSize += MIN_NODE_SIZE << level;
+	allocationCount++;
+
+	_offset = unit * MIN_NODE_SIZE;
+	return true;
+}
+
+void BuddyAllocator::free(uint64_t _offset)
+{
+	uint32_t unit = static_cast<uint32_t>(_offset / MIN_NODE_SIZE);
+	uint32_t level = allocatedLevels[unit];
+	if (level == NO_LEVEL)
+		throw std::runtime_error("buddy allocator : freeing an unallocated node!");
+
+	allocatedLevels[unit] = NO_LEVEL;
+	usedSize -= MIN_NODE_SIZE << level;
+	allocationCount--;
+
+	// merge with the buddy as long as it is free as a whole
+	while (level + 1 < levelCount)
+	{
+		const uint32_t buddy = unit ^ (1u << level);
+		if (freeLevels[buddy] != level)
+			break;
+
+		removeFree(buddy, level);
+		unit = std::min(unit, buddy);
+		level++;
+	}
+
+	pushFree(unit, level);
+}
+
+uint64_t BuddyAllocator::getNodeSize(uint64_t _size, uint64_t _alignment)
+{
+	uint64_t nodeSize = MIN_NODE_SIZE;
+	while (nodeSize < _size || nodeSize < _alignment)
+		nodeSize <<= 1;
+
+	return nodeSize;
+}
+
+uint64_t BuddyAllocator::getLargestFreeSize() const
+{
+	if (freeLevelMask == 0)
+		return 0;
+
+	return MIN_NODE_SIZE << log2Floor(freeLevelMask);
+}
+
+void BuddyAllocator::pushFree(uint32_t _unit, uint32_t _level)
+{
+	const uint32_t head = freeHeads[_level];
+
+	nextFree[_unit] = head;
+	previousFree[_unit] = NO_NODE;
+	if (head != NO_NODE)
+		previousFree[head] = _unit;
+
+	freeHeads[_level] = _unit;
+	freeLevels[_unit] = static_cast<uint8_t>(_level);
+	freeLevelMask |= uint64_t(1) << _level;
+}
+
+void BuddyAllocator::removeFree(uint32_t _unit, uint32_t _level)
+{
+	if (previousFree[_unit] != NO_NODE)
+		nextFree[previousFree[_unit]] = nextFree[_unit];
+	else
+		freeHeads[_level] = nextFree[_unit];
+
+	if (nextFree[_unit] != NO_NODE)
+		previousFree[nextFree[_unit]] = previousFree[_unit];
+
+	freeLevels[_unit] = NO_LEVEL;
+	if (freeHeads[_level] == NO_NODE)
+		freeLevelMask &= ~(uint64_t(1) << _level);
+}
+
+void DeviceMemoryAllocator::create(VkDevice _device, const VkPhysicalDeviceMemoryProperties& _memoryProperties, VkDeviceSize _bufferImageGranularity, VkDeviceSize _blockSize)
+{
+	device = _device;
+	memoryProperties = _memoryProperties;
+	separateOptimalImages = (_bufferImageGranularity > BuddyAllocator::MIN_NODE_SIZE);
+
+	pools.clear();
+	pools.resize(memoryProperties.memoryTypeCount * 2);
+
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		// a power of two, and no more than an eighth of the heap so small heaps (host visible device local) aren't taken by one block
+		const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+		VkDeviceSize blockSize = VkDeviceSize(1) << log2Floor(std::min(_blockSize, heapSize / 8));
+		blockSize = std::max<VkDeviceSize>(blockSize, BuddyAllocator::MIN_NODE_SIZE);
+
+		pools[i * 2].blockSize = blockSize;
+		pools[i * 2 + 1].blockSize = blockSize;
+	}
+
+	stats = DeviceMemoryStats{};
+}
+
+void DeviceMemoryAllocator::destroy()
+{
+	for (Pool& pool : pools)
+	{
+		for (std::unique_ptr<Block>& block : pool.blocks)
+		{
+			if (block != nullptr)
+				freeDeviceMemory(block->memory);
+		}
+	}
+
+	pools.clear();
+}
+
+DeviceAllocation DeviceMemoryAllocator::allocate(const VkMemoryRequirements& _requirements, uint32_t _memoryTypeIndex, bool _optimalImage)
+{
+	const uint32_t poolIndex = _memoryTypeIndex * 2 + ((separateOptimalImages == true && _optimalImage == true) ? 1 : 0);
+	Pool& pool = pools[poolIndex];
+
+	DeviceAllocation allocation;
+	allocation.size = _requirements.size;
+
+	// the buddy node, not the size, is what has to fit : alignment can round it up past half a block
+	if (BuddyAllocator::getNodeSize(_requirements.size, _requirements.alignment) > pool.blockSize / 2)
+	{
+		allocation.memory = allocateDeviceMemory(_requirements.size, _memoryTypeIndex, allocation.mappedData);
+
+		stats.dedicatedCount++;
+		stats.dedicatedBytes += _requirements.size;
+		stats.allocationCount++;
+		stats.requestedBytes += _requirements.size;
+		stats.usedBytes += _requirements.size;
+
+		return allocation;
+	}
+
+	// first block with room, else a new one in the first released slot
+	uint32_t blockIndex = UINT32_MAX;
+	VkDeviceSize offset = 0;
+	for (uint32_t i = 0; i < pool.blocks.size() && blockIndex == UINT32_MAX; i++)
+	{
+		if (pool.blocks[i] != nullptr && pool.blocks[i]->buddy.allocate(_requirements.size, _requirements.alignment, offset) == true)
+		{
+			blockIndex = i;
+			if (pool.blocks[i]->buddy.getAllocationCount() == 1)
+				pool.emptyBlockCount--;
+		}
+	}
+
+	if (blockIndex == UINT32_MAX)
+	{
+		std::unique_ptr<Block> block(new Block());
+		block->memory = allocateDeviceMemory(pool.blockSize, _memoryTypeIndex, block->mappedData);
+		block->buddy.reset(pool.blockSize);
+
+		if (block->buddy.allocate(_requirements.size, _requirements.alignment, offset) == false)
+		{
+			freeDeviceMemory(block->memory);
+			throw std::runtime_error("failed to suballocate from a new device memory block!");
+		}
+
+		auto slot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+		blockIndex = static_cast<uint32_t>(slot - pool.blocks.begin());
+		if (slot == pool.blocks.end())
+			pool.blocks.push_back(std::move(block));
+		else
+			*slot = std::move(block);
+
+		stats.blockCount++;
+		stats.blockBytes += pool.blockSize;
+		stats.peakBlockBytes = std::max(stats.peakBlockBytes, stats.blockBytes);
+	}
+
+	Block& block = *pool.blocks[blockIndex];
+
+	allocation.memory = block.memory;
+	allocation.offset = offset;
+	allocation.mappedData = (block.mappedData != nullptr) ? block.mappedData + offset : nullptr;
+	allocation.pool = poolIndex;
+	allocation.block = blockIndex;
+
+	stats.allocationCount++;
+	stats.requestedBytes += _requirements.size;
+	stats.usedBytes += BuddyAllocator::getNodeSize(_requirements.size, _requirements.alignment);
+
+	return allocation;
+}
+
+void DeviceMemoryAllocator::free(DeviceAllocation& _allocation)
+{
+	// never allocated, or freed already
+	if (_allocation.size == 0)
+		return;
+
+	stats.allocationCount--;
+	stats.requestedBytes -= _allocation.size;
+
+	if (_allocation.pool == UINT32_MAX)
+	{
+		freeDeviceMemory(_allocation.memory);
+
+		stats.dedicatedCount--;
+		stats.dedicatedBytes -= _allocation.size;
+		stats.usedBytes -= _allocation.size;
+	}
+	else
+	{
+		Pool& pool = pools[_allocation.pool];
+		std::unique_ptr<Block>& block = pool.blocks[_allocation.block];
+
+		const VkDeviceSize usedBefore = block->buddy.getUsedSize();
+		block->buddy.free(_allocation.offset);
+		stats.usedBytes -= usedBefore - block->buddy.getUsedSize();
+
+		if (block->buddy.isEmpty() == true)
+		{
+			if (pool.emptyBlockCount > 0)
+			{
+				freeDeviceMemory(block->memory);
+				block.reset();
+
+				stats.blockCount--;
+				stats.blockBytes -= pool.blockSize;
+			}
+			else
+				pool.emptyBlockCount++;
+		}
+	}
+
+	_allocation = DeviceAllocation{};
+}
+
+VkDeviceMemory DeviceMemoryAllocator::allocateDeviceMemory(VkDeviceSize _size, uint32_t _memoryTypeIndex, char*& _mappedData)
+{
+	stats.deviceAllocationCount++;
+	_mappedData = nullptr;
+
+	if (device == VK_NULL_HANDLE)
+		return VK_NULL_HANDLE;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = _size;
+	allocInfo.memoryTypeIndex = _memoryTypeIndex;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		throw std::runtime_error("failed to allocate device memory!");
+
+	// mapped once for the lifetime of the block, a memory object can't be mapped twice
+	if ((memoryProperties.memoryTypes[_memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0)
+	{
+		void* data;
+		vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data);
+		_mappedData = static_cast<char*>(data);
+	}
+
+	return memory;
+}
+
+void DeviceMemoryAllocator::freeDeviceMemory(VkDeviceMemory _memory)
+{
+	// freeing the memory unmaps it
+	if (device != VK_NULL_HANDLE)
+		vkFreeMemory(device, _memory, nullptr);
+}
@@ -0,0 +1,135 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Binary buddy allocator over a power of two range : nodes are powers of two and aligned to their own size,
+// so any power of two alignment up to the node size comes for free. Allocation and free are O(levels).
+class BuddyAllocator
+{
+public:
+	static constexpr uint64_t MIN_NODE_SIZE = 256;
+
+	// _size : a power of two, at least MIN_NODE_SIZE
+	void reset(uint64_t _size);
+
+	// false when no free node is large enough
+	bool allocate(uint64_t _size, uint64_t _alignment, uint64_t& _offset);
+	void free(uint64_t _offset);
+
+	uint64_t getSize() const { return size; }
+	uint64_t getUsedSize() const { return usedSize; } // allocated node sizes, including the rounding
+	uint32_t getAllocationCount() const { return allocationCount; }
+	uint64_t getLargestFreeSize() const;
+
+	bool isEmpty() const { return allocationCount == 0; }
+
+	// what an allocation of _size bytes at _alignment takes
+	static uint64_t getNodeSize(uint64_t _size, uint64_t _alignment);
+
+private:
+	static constexpr uint32_t NO_NODE = UINT32_MAX;
+	static constexpr uint8_t NO_LEVEL = UINT8_MAX;
+
+	void pushFree(uint32_t _unit, uint32_t _level);
+	void removeFree(uint32_t _unit, uint32_t _level);
+
+private:
+	uint64_t size = 0;
+	uint32_t levelCount = 0; // level l nodes are MIN_NODE_SIZE << l bytes
+
+	// free lists per level, linked through the first MIN_NODE_SIZE unit of each node
+	std::vector<uint32_t> freeHeads;
+	uint64_t freeLevelMask = 0; // bit l : freeHeads[l] isn't empty
+	std::vector<uint32_t> nextFree;
+	std::vector<uint32_t> previousFree;
+
+	// per unit, the level of the free / allocated node starting there
+	std::vector<uint8_t> freeLevels;
+	std::vector<uint8_t> allocatedLevels;
+
+	uint64_t usedSize = 0;
+	uint32_t allocationCount = 0;
+};
+
+// Suballocated device memory, bind the resource at memory + offset
+struct DeviceAllocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0; // as required by the resource, 0 when not allocated
+	char* mappedData = nullptr; // at offset, persistently mapped for host visible memory types
+
+	// owner inside the allocator
+	uint32_t pool = UINT32_MAX;
+	uint32_t block = UINT32_MAX;
+};
+
+struct DeviceMemoryStats
+{
+	uint32_t blockCount = 0;
+	VkDeviceSize blockBytes = 0;
+	VkDeviceSize peakBlockBytes = 0;
+	uint32_t dedicatedCount = 0;
+	VkDeviceSize dedicatedBytes = 0;
+
+	uint32_t allocationCount = 0; // live, blocks and dedicated
+	VkDeviceSize requestedBytes = 0; // sizes asked for by the live allocations
+	VkDeviceSize usedBytes = 0; // after rounding to buddy nodes
+
+	uint64_t deviceAllocationCount = 0; // vkAllocateMemory calls so far
+};
+
+// Reserves large blocks of device memory per memory type and suballocates resources from them
+// instead of one vkAllocateMemory per resource, which is slow and runs into maxMemoryAllocationCount.
+//
+// Linear (buffers) and optimal (images) resources only share blocks when bufferImageGranularity is no
+// larger than the smallest buddy node : nodes are then whole granularity pages and never share one.
+// Resources larger than half a block get a dedicated allocation.
+class DeviceMemoryAllocator
+{
+public:
+	static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+	// _device : VK_NULL_HANDLE for blocks without any device memory behind them, to benchmark the suballocation
+	void create(VkDevice _device, const VkPhysicalDeviceMemoryProperties& _memoryProperties, VkDeviceSize _bufferImageGranularity, VkDeviceSize _blockSize = DEFAULT_BLOCK_SIZE);
+
+	// frees every block, live allocations included
+	void destroy();
+
+	// _optimalImage : VK_IMAGE_TILING_OPTIMAL images, everything else is linear
+	DeviceAllocation allocate(const VkMemoryRequirements& _requirements, uint32_t _memoryTypeIndex, bool _optimalImage);
+	void free(DeviceAllocation& _allocation);
+
+	const DeviceMemoryStats& getStats() const { return stats; }
+
+private:
+	struct Block
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		char* mappedData = nullptr;
+		BuddyAllocator buddy;
+	};
+
+	// the blocks of one memory type and resource kind
+	struct Pool
+	{
+		std::vector<std::unique_ptr<Block>> blocks; // nullptr : released slot
+		VkDeviceSize blockSize = 0;
+		uint32_t emptyBlockCount = 0; // at most one, kept so a pool that empties and refills doesn't reallocate every time
+	};
+
+	VkDeviceMemory allocateDeviceMemory(VkDeviceSize _size, uint32_t _memoryTypeIndex, char*& _mappedData);
+	void freeDeviceMemory(VkDeviceMemory _memory);
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	bool separateOptimalImages = false;
+
+	std::vector<Pool> pools; // memory type * 2 + (optimal image)
+
+	DeviceMemoryStats stats;
+};
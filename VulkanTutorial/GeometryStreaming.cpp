@@ -0,0 +1,216 @@
+﻿#include "GeometryStreaming.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+	struct TriangleRange
+	{
+		size_t begin;
+		size_t end;
+	};
+
+	void appendChunk(ChunkedMesh& _mesh, const uint32_t* _triangles, size_t _triangleCount, const uint32_t* _indices, const Vertex* _vertices, std::vector<uint32_t>& _localIndices)
+	{
+		MeshChunk chunk{};
+		chunk.firstVertex = static_cast<uint32_t>(_mesh.vertices.size());
+		chunk.firstIndex = static_cast<uint32_t>(_mesh.indices.size());
+
+		// vertices in first use order, _localIndices is all UINT32_MAX again on return
+		for (size_t t = 0; t < _triangleCount; t++)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t index = _indices[_triangles[t] * 3 + corner];
+
+				if (_localIndices[index] == UINT32_MAX)
+				{
+					_localIndices[index] = chunk.vertexCount++;
+					_mesh.vertices.push_back(_vertices[index]);
+				}
+
+				_mesh.indices.push_back(static_cast<uint16_t>(_localIndices[index]));
+			}
+		}
+
+		chunk.indexCount = static_cast<uint32_t>(_triangleCount * 3);
+
+		// bounding sphere around the bounding box center
+		glm::vec3 minimum(FLT_MAX);
+		glm::vec3 maximum(-FLT_MAX);
+		for (uint32_t i = 0; i < chunk.vertexCount; i++)
+		{
+			const Vertex& vertex = _mesh.vertices[chunk.firstVertex + i];
+			minimum = glm::min(minimum, vertex.pos);
+			maximum = glm::max(maximum, vertex.pos);
+		}
+
+		const glm::vec3 center = (minimum + maximum) * 0.5f;
+		float radius = 0.0f;
+		for (uint32_t i = 0; i < chunk.vertexCount; i++)
+			radius = std::max(radius, glm::distance(center, _mesh.vertices[chunk.firstVertex + i].pos));
+
+		chunk.boundingSphere = glm::vec4(center, radius);
+
+		for (size_t t = 0; t < _triangleCount; t++)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+				_localIndices[_indices[_triangles[t] * 3 + corner]] = UINT32_MAX;
+		}
+
+		_mesh.chunks.push_back(chunk);
+	}
+}
+
+ChunkedMesh BuildMeshChunks(const uint32_t* _indices, size_t _indexCount, const Vertex* _vertices, size_t _vertexCount)
+{
+	ChunkedMesh mesh;
+
+	const size_t triangleCount = _indexCount / 3;
+	if (triangleCount == 0)
+		return mesh;
+
+	std::vector<uint32_t> triangles(triangleCount);
+	std::vector<glm::vec3> centroids(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangles[t] = static_cast<uint32_t>(t);
+		centroids[t] = (_vertices[_indices[t * 3]].pos + _vertices[_indices[t * 3 + 1]].pos + _vertices[_indices[t * 3 + 2]].pos) / 3.0f;
+	}
+
+	mesh.vertices.reserve(_vertexCount);
+	mesh.indices.reserve(_indexCount);
+
+	std::vector<uint32_t> localIndices(_vertexCount, UINT32_MAX);
+
+	// depth first, so neighbouring chunks are also close in the chunk list
+	std::vector<TriangleRange> stack = { { 0, triangleCount } };
+	while (stack.empty() == false)
+	{
+		const TriangleRange range = stack.back();
+		stack.pop_back();
+
+		const size_t count = range.end - range.begin;
+		if (count <= MESH_CHUNK_MAX_TRIANGLES)
+		{
+			// back to index buffer order
+			std::sort(triangles.begin() + range.begin, triangles.begin() + range.end);
+			appendChunk(mesh, triangles.data() + range.begin, count, _indices, _vertices, localIndices);
+			continue;
+		}
+
+		glm::vec3 minimum(FLT_MAX);
+		glm::vec3 maximum(-FLT_MAX);
+		for (size_t t = range.begin; t < range.end; t++)
+		{
+			minimum = glm::min(minimum, centroids[triangles[t]]);
+			maximum = glm::max(maximum, centroids[triangles[t]]);
+		}
+
+		const glm::vec3 extent = maximum - minimum;
+		const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+
+		const size_t middle = range.begin + count / 2;
+		std::nth_element(triangles.begin() + range.begin, triangles.begin() + middle, triangles.begin() + range.end,
+			[&centroids, axis](uint32_t _a, uint32_t _b) { return centroids[_a][axis] < centroids[_b][axis]; });
+
+		stack.push_back({ middle, range.end });
+		stack.push_back({ range.begin, middle });
+	}
+
+	return mesh;
+}
+
+void GeometryPool::reset(uint32_t _slotCount, size_t _chunkCount)
+{
+	slots.assign(_slotCount, Slot{});
+	chunkSlots.assign(_chunkCount, NO_SLOT);
+
+	// every slot starts empty, in slot order
+	for (uint32_t i = 0; i < _slotCount; i++)
+	{
+		slots[i].previous = (i > 0) ? i - 1 : NO_SLOT;
+		slots[i].next = (i + 1 < _slotCount) ? i + 1 : NO_SLOT;
+	}
+
+	head = (_slotCount > 0) ? 0 : NO_SLOT;
+	tail = (_slotCount > 0) ? _slotCount - 1 : NO_SLOT;
+
+	loadCount = 0;
+	evictionCount = 0;
+}
+
+void GeometryPool::touch(uint32_t _chunk, uint64_t _frame)
+{
+	const uint32_t slot = chunkSlots[_chunk];
+	if (slot == NO_SLOT)
+		return;
+
+	slots[slot].lastUse = _frame;
+
+	unlink(slot);
+	pushFront(slot);
+}
+
+uint32_t GeometryPool::load(uint32_t _chunk, uint64_t _frame, uint64_t _inFlightFrame)
+{
+	if (chunkSlots[_chunk] != NO_SLOT)
+	{
+		touch(_chunk, _frame);
+		return chunkSlots[_chunk];
+	}
+
+	const uint32_t slot = tail;
+	if (slot == NO_SLOT)
+		return NO_SLOT;
+
+	if (slots[slot].chunk != NO_CHUNK)
+	{
+		if (slots[slot].lastUse >= _inFlightFrame)
+			return NO_SLOT;
+
+		chunkSlots[slots[slot].chunk] = NO_SLOT;
+		evictionCount++;
+	}
+
+	slots[slot].chunk = _chunk;
+	slots[slot].lastUse = _frame;
+	chunkSlots[_chunk] = slot;
+	loadCount++;
+
+	unlink(slot);
+	pushFront(slot);
+
+	return slot;
+}
+
+void GeometryPool::unlink(uint32_t _slot)
+{
+	Slot& slot = slots[_slot];
+
+	if (slot.previous != NO_SLOT)
+		slots[slot.previous].next = slot.next;
+	else
+		head = slot.next;
+
+	if (slot.next != NO_SLOT)
+		slots[slot.next].previous = slot.previous;
+	else
+		tail = slot.previous;
+
+	slot.previous = NO_SLOT;
+	slot.next = NO_SLOT;
+}
+
+void GeometryPool::pushFront(uint32_t _slot)
+{
+	slots[_slot].next = head;
+
+	if (head != NO_SLOT)
+		slots[head].previous = _slot;
+	else
+		tail = _slot;
+
+	head = _slot;
+}
@@ -0,0 +1,96 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// limit of one chunk, small enough for 16 bit chunk local indices
+const uint32_t MESH_CHUNK_MAX_TRIANGLES = 4096;
+
+static_assert(MESH_CHUNK_MAX_TRIANGLES * 3 <= 65536, "chunk local indices must fit in 16 bits");
+
+// Spatially compact piece of a mesh with its own vertices, the unit of geometry streaming.
+struct MeshChunk
+{
+	glm::vec4 boundingSphere;	// xyz center, w radius
+	uint32_t firstVertex;		// into ChunkedMesh::vertices
+	uint32_t vertexCount;
+	uint32_t firstIndex;		// into ChunkedMesh::indices
+	uint32_t indexCount;		// relative to firstVertex
+};
+
+struct ChunkedMesh
+{
+	std::vector<MeshChunk> chunks;
+	std::vector<Vertex> vertices;
+	std::vector<uint16_t> indices;
+};
+
+// Chunked mesh data, owned by a ChunkedMesh or by the mapped mesh cache.
+struct ChunkedMeshView
+{
+	const MeshChunk* chunks = nullptr;
+	size_t chunkCount = 0;
+	const Vertex* vertices = nullptr;
+	const uint16_t* indices = nullptr;
+};
+
+// Splits a triangle list at the median triangle centroid along the longest axis until every piece has
+// at most MESH_CHUNK_MAX_TRIANGLES. Triangles keep their relative order inside a chunk,
+// so a vertex cache optimized index buffer stays optimized.
+ChunkedMesh BuildMeshChunks(const uint32_t* _indices, size_t _indexCount, const Vertex* _vertices, size_t _vertexCount);
+
+// Residency of chunks in a fixed number of equally sized GPU slots.
+// Loading a chunk into a full pool evicts the least recently used one.
+class GeometryPool
+{
+public:
+	static const uint32_t NO_CHUNK = UINT32_MAX;
+	static const uint32_t NO_SLOT = UINT32_MAX;
+
+	// empties the pool
+	void reset(uint32_t _slotCount, size_t _chunkCount);
+
+	uint32_t getSlotCount() const { return static_cast<uint32_t>(slots.size()); }
+
+	// NO_SLOT when the chunk isn't resident
+	uint32_t getSlot(uint32_t _chunk) const { return chunkSlots[_chunk]; }
+
+	// NO_CHUNK when the slot is empty
+	uint32_t getChunk(uint32_t _slot) const { return slots[_slot].chunk; }
+	uint64_t getLastUse(uint32_t _slot) const { return slots[_slot].lastUse; }
+
+	// marks a resident chunk as used by _frame
+	void touch(uint32_t _chunk, uint64_t _frame);
+
+	// moves _chunk into the least recently used slot and marks it used by _frame.
+	// a slot last used at or after _inFlightFrame may still be read by the GPU, NO_SLOT is returned instead of evicting it
+	uint32_t load(uint32_t _chunk, uint64_t _frame, uint64_t _inFlightFrame);
+
+	size_t getLoadCount() const { return loadCount; }
+	size_t getEvictionCount() const { return evictionCount; }
+
+private:
+	void unlink(uint32_t _slot);
+	void pushFront(uint32_t _slot);
+
+private:
+	// doubly linked from most (head) to least (tail) recently used
+	struct Slot
+	{
+		uint32_t chunk = NO_CHUNK;
+		uint64_t lastUse = 0;
+		uint32_t previous = NO_SLOT;
+		uint32_t next = NO_SLOT;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> chunkSlots;
+
+	uint32_t head = NO_SLOT;
+	uint32_t tail = NO_SLOT;
+
+	size_t loadCount = 0;
+	size_t evictionCount = 0;
+};
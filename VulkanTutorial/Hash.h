@@ -0,0 +1,52 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// 64-bit finalizer (MurmurHash3 fmix64) : every input bit affects every output bit.
+inline uint64_t hashMix64(uint64_t _value)
+{
+	_value ^= _value >> 33;
+	_value *= 0xff51afd7ed558ccdULL;
+	_value ^= _value >> 33;
+	_value *= 0xc4ceb9fe1a85ec53ULL;
+	_value ^= _value >> 33;
+	return _value;
+}
+
+// Fast non-cryptographic hash of a byte range, 32 bytes per step on four independent lanes.
+inline uint64_t hashBytes(const void* _data, size_t _size, uint64_t _seed = 0)
+{
+	const uint64_t prime = 0x9e3779b97f4a7c15ULL;
+	const unsigned char* bytes = static_cast<const unsigned char*>(_data);
+
+	uint64_t lanes[4] = { _seed ^ prime, _seed + prime, _seed ^ (prime << 1), _seed - prime };
+
+	size_t offset = 0;
+	for (; offset + 32 <= _size; offset += 32)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			uint64_t word;
+			memcpy(&word, bytes + offset + 8 * i, sizeof(word));
+
+			lanes[i] = (lanes[i] ^ word) * prime;
+			lanes[i] = (lanes[i] << 31) | (lanes[i] >> 33);
+		}
+	}
+
+	uint64_t hash = hashMix64(lanes[0]) ^ hashMix64(lanes[1] + 1) ^ hashMix64(lanes[2] + 2) ^ hashMix64(lanes[3] + 3);
+
+	for (; offset + 8 <= _size; offset += 8)
+	{
+		uint64_t word;
+		memcpy(&word, bytes + offset, sizeof(word));
+		hash = hashMix64(hash ^ word);
+	}
+
+	uint64_t tail = 0;
+	if (_size > offset)
+		memcpy(&tail, bytes + offset, _size - offset);
+
+	return hashMix64(hash ^ tail ^ static_cast<uint64_t>(_size));
+}
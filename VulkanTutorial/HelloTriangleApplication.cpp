@@ -1,13 +1,26 @@
 ﻿#include "HelloTriangleApplication.h"
 
+#include "GeometryStreaming.h"
+#include "Hash.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlet.h"
+#include "ObjLoader.h"
+#include "StartupTimeline.h"
+#include "UploadBatch.h"
+#include "VertexDeduplicator.h"
+#include "VertexStreams.h"
+
 #include <algorithm> // Necessary for std::min/std::max
 #include <cstdint> // Necessary for UINT32_MAX
 #include <cstdlib>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <random>
 #include <set>
 #include <stdexcept>
-#include <unordered_map>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
@@ -34,6 +47,7 @@ const uint32_t HEIGHT = 600;
 
 const std::string MODEL_PATH = "resources/viking_room.obj";
 const std::string TEXTURE_PATH = "resources/viking_room.png";
+const std::string MESH_CACHE_PATH = MODEL_PATH + ".meshcache";
 
 // validation layer
 const std::vector<const char*> validationLayers = {
@@ -45,7 +59,100 @@ const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+// frames the CPU records ahead of the GPU, 1 - 4, each with its own uniforms, draw buffers and command buffers.
+// RunFrameBenchmark() measures every setting
+const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+
+static_assert(MAX_FRAMES_IN_FLIGHT >= 1 && MAX_FRAMES_IN_FLIGHT <= 4, "1 to 4 frames in flight");
+
+// frames drawn before each frame benchmark setting is measured, to fill the queue
+const uint32_t FRAME_BENCHMARK_WARMUP_FRAMES = 60;
+
+// split the scene's draws over up to RECORDING_THREAD_COUNT threads (0 : every threadPool worker and the main thread),
+// each recording a secondary command buffer from its own pool, as long as every thread gets RECORDING_MIN_DRAWS_PER_THREAD draws
+const bool enableParallelRecording = true;
+const uint32_t RECORDING_THREAD_COUNT = 0;
+const uint32_t RECORDING_MIN_DRAWS_PER_THREAD = 256;
+
+// parse the model with the multithreaded chunked parser instead of tinyobj::LoadObj
+const bool enableParallelObjParsing = true;
+
+// reuse the processed mesh from MESH_CACHE_PATH while the source model is unchanged
+const bool enableMeshCache = true;
+
+// deduplicate on the obj position / texcoord indices first and only build and hash a Vertex for new ones,
+// instead of hashing every corner's Vertex (the result is the same)
+const bool enableIndexDeduplication = true;
+
+// reorder triangles for the post-transform vertex cache and vertices for fetch locality after loading
+const bool enableMeshOptimization = true;
+
+// upload 16 byte CompactVertex instead of 32 byte Vertex (positions dequantized through the model matrix)
+// falls back to Vertex for models with texture coordinates outside [0, 1]
+const bool enableVertexQuantization = true;
+
+// store positions and the other attributes as two vertex streams (bindings 0 and 1) in the vertex buffer,
+// so position-only passes can bind just the position stream
+const bool enableSplitVertexStreams = true;
+
+// use 16 bit indices for models with fewer than 65536 vertices
+const bool enable16BitIndices = true;
+
+// after the vertex cache pass, reorder triangle clusters to draw outward facing ones first (needs enableMeshOptimization)
+// the scene is fill-rate bound at high msaa, so this trades a little vertex cache efficiency for less overdraw
+const bool enableOverdrawOptimization = true;
+
+// split the model into meshlets and cull them against the frustum and their normal cones in a compute pass,
+// drawing the surviving triangles indirectly from a compacted index buffer
+// shaders/meshlet_cull.spv is compiled by the project build, like vert.spv and frag.spv
+const bool enableMeshletCulling = false;
+
+// build a chain of simplified index buffers after loading and draw the coarsest level whose error projects
+// to at most LOD_MAX_PIXEL_ERROR pixels (LOD 0 is drawn while enableMeshletCulling is on)
+const bool enableLodChain = true;
+const uint32_t MAX_LOD_COUNT = 5;
+const float LOD_MAX_PIXEL_ERROR = 1.0f;
+
+// for models larger than device memory : split the model into spatial chunks stored in the mesh cache and keep
+// only the ones nearest the camera in a GEOMETRY_POOL_SIZE pool, paging in up to STREAMING_UPLOADS_PER_FRAME
+// chunks a frame over the least recently used ones (the LOD chain isn't used while streaming)
+const bool enableGeometryStreaming = false;
+const VkDeviceSize GEOMETRY_POOL_SIZE = 64 * 1024 * 1024;
+const uint32_t STREAMING_UPLOADS_PER_FRAME = 8;
+
+static_assert(enableGeometryStreaming == false || enableMeshletCulling == false, "meshlet culling needs the whole index buffer on the device");
+
+// stress scene : draw INSTANCE_COUNT copies of the model in one draw, on a square grid INSTANCE_SPACING apart,
+// each with its own rotation and scale from an instance rate vertex binding
+// shaders/instanced_vert.spv is compiled by the project build
+const bool enableInstancing = false;
+const uint32_t INSTANCE_COUNT = 128 * 1024;
+const float INSTANCE_SPACING = 2.5f;
+
+static_assert(enableInstancing == false || (enableMeshletCulling == false && enableGeometryStreaming == false), "the culling and streaming draws are single instance");
+
+// GPU driven instancing : a compute pass culls every instance against the frustum, picks its LOD and compacts
+// the visible ones into one indirect draw per LOD, issued with vkCmdDrawIndexedIndirectCount when the device has
+// VK_KHR_draw_indirect_count. The CPU records the same few commands whatever the instance count.
+// shaders/instance_cull.spv is compiled by the project build
+const bool enableInstanceCulling = false;
+
+static_assert(enableInstanceCulling == false || enableInstancing == true, "instance culling draws the instancing stress scene");
+static_assert(MAX_LOD_COUNT <= INSTANCE_CULLING_MAX_LOD_COUNT, "the instance culling pass draws every LOD");
+static_assert(INSTANCE_COUNT < (1u << 24), "the instance culling pass packs an instance's place among its LOD's into 24 bits");
+
+// print the startup stages and their critical path once the loaded assets are in
+const bool enableStartupReport = true;
+
+// run upload copies on a transfer-only queue family when the device has one, handing the resources over to the graphics queue
+const bool enableTransferQueue = true;
+
+// persistently mapped staging memory every upload suballocates from, reused once the GPU is done with it.
+// bounds staging memory, only an upload larger than the whole ring gets a buffer of its own
+const VkDeviceSize STAGING_RING_SIZE = 32 * 1024 * 1024;
+
+// per frame in flight region of the persistently mapped uniform ring, holds every uniform pushed in a frame
+const VkDeviceSize UNIFORM_RING_FRAME_SIZE = 64 * 1024;
 
 VkResult CreateDebugUtilsMessengerEXT(VkInstance _instance, const VkDebugUtilsMessengerCreateInfoEXT* _pCreateInfo, const VkAllocationCallbacks* _pAllocator, VkDebugUtilsMessengerEXT* _pDebugMessenger)
 {
@@ -66,9 +173,67 @@ void DestroyDebugUtilsMessengerEXT(VkInstance _instance, VkDebugUtilsMessengerEX
 		func(_instance, _debugMessenger, _pAllocator);
 }
 
+// rgba8, runs on the asset loading workers
+DecodedTexture DecodeTexture(const std::string& _path)
+{
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load(_path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+	if (pixels == nullptr) 
+		throw std::runtime_error("failed to load texture image!");
+
+	DecodedTexture texture;
+	texture.width = static_cast<uint32_t>(texWidth);
+	texture.height = static_cast<uint32_t>(texHeight);
+	texture.pixels.assign(pixels, pixels + static_cast<size_t>(texWidth) * texHeight * 4);
+
+	stbi_image_free(pixels);
+
+	return texture;
+}
+
+Vertex BuildVertex(const tinyobj::attrib_t& _attrib, const tinyobj::index_t& _index)
+{
+	Vertex vertex{};
+
+	vertex.pos = {
+		_attrib.vertices[3 * _index.vertex_index + 0],
+		_attrib.vertices[3 * _index.vertex_index + 1],
+		_attrib.vertices[3 * _index.vertex_index + 2]
+	};
+
+	vertex.texCoord = {
+		_attrib.texcoords[2 * _index.texcoord_index + 0],
+		1.0f - _attrib.texcoords[2 * _index.texcoord_index + 1]
+	};
+
+	vertex.color = { 1.0f, 1.0f, 1.0f };
+
+	return vertex;
+}
+
+// the loadModel() settings that change the processed mesh, a cache written with other ones is stale
+uint64_t MeshProcessingKey()
+{
+	const uint32_t settings[] = {
+		enableIndexDeduplication,
+		enableMeshOptimization,
+		enableOverdrawOptimization,
+		enableLodChain,
+		MAX_LOD_COUNT
+	};
+
+	return hashBytes(settings, sizeof(settings));
+}
+
 void HelloTriangleApplication::Run()
 {
-	initWindow();
+	framesInFlight = MAX_FRAMES_IN_FLIGHT;
+
+	// decoding, parsing and shader reads run on the pool while the window, device and swap chain are set up
+	startAssetLoading();
+
+	startupTimeline.time("window", true, [this]() { initWindow(); });
 
 	initVulkan();
 
@@ -77,6 +242,83 @@ void HelloTriangleApplication::Run()
 	cleanup();
 }
 
+void HelloTriangleApplication::RunFrameBenchmark(uint32_t _frameCount, uint32_t _drawCount)
+{
+	frameBenchmark = true;
+	framesInFlight = MAX_FRAMES_IN_FLIGHT;
+	sceneDrawCount = std::max(_drawCount, 1u);
+
+	startAssetLoading();
+	initWindow();
+	initVulkan();
+
+	// every setting draws the loaded assets, not the placeholders
+	while (glfwWindowShouldClose(window) == false && (modelLoad.valid() == true || textureLoad.valid() == true))
+	{
+		glfwPollEvents();
+		pollAssetLoading();
+		drawFrame();
+	}
+
+	std::cout << "frame benchmark : " << _frameCount << " frames per setting, the scene drawn " << sceneDrawCount << " times a frame";
+	if (enableInstancing == true)
+		std::cout << " with " << instanceCount << " instances per draw";
+	if (enableInstanceCulling == true)
+		std::cout << ", culled on the GPU";
+	if (timestampQueryPool == VK_NULL_HANDLE)
+		std::cout << ", no GPU timestamps on the graphics queue";
+	std::cout << std::endl;
+
+	for (uint32_t frames = 1; frames <= 4 && glfwWindowShouldClose(window) == false; frames++)
+	{
+		setFramesInFlight(frames);
+
+		const double totalMs = measureFrames(_frameCount);
+		const double frameCount = std::max<uint32_t>(frameStats.frameCount, 1);
+
+		std::cout << std::fixed << std::setprecision(3) << "frames in flight " << frames
+			<< " : cpu " << frameStats.cpuMs / frameCount << " ms (+ " << frameStats.waitMs / frameCount << " ms waiting for the GPU), gpu ";
+		if (frameStats.gpuFrameCount > 0)
+			std::cout << frameStats.gpuMs / frameStats.gpuFrameCount << " ms";
+		else
+			std::cout << "n/a";
+		std::cout << ", record " << frameStats.recordMs * 1000.0 / frameCount << " us for " << frameStats.drawCount / frameCount << " draws ("
+			<< frameStats.recordMs * 1000000.0 / std::max<uint64_t>(frameStats.drawCount, 1) << " ns per draw)";
+		std::cout << ", " << std::setprecision(1) << frameStats.frameCount * 1000.0 / totalMs << " frames/s" << std::endl;
+	}
+
+	// recording time against the number of threads splitting the draws, 1, 2, 4 ... and every recording slot
+	setFramesInFlight(MAX_FRAMES_IN_FLIGHT);
+
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threads = 1; threads < recordingSlotCount; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(recordingSlotCount);
+
+	double singleThreadRecordMs = 0.0;
+	for (uint32_t threads : threadCounts)
+	{
+		if (glfwWindowShouldClose(window) == true)
+			break;
+
+		recordingThreadCount = threads;
+
+		const double totalMs = measureFrames(_frameCount);
+		const double frameCount = std::max<uint32_t>(frameStats.frameCount, 1);
+		const double recordMs = frameStats.recordMs / frameCount;
+		if (threads == 1)
+			singleThreadRecordMs = recordMs;
+
+		std::cout << std::fixed << std::setprecision(3) << "recording threads " << threads << " (" << getRecordingJobCount() << " secondary command buffers)"
+			<< " : record " << recordMs * 1000.0 << " us (" << frameStats.recordMs * 1000000.0 / std::max<uint64_t>(frameStats.drawCount, 1) << " ns per draw), "
+			<< std::setprecision(2) << singleThreadRecordMs / recordMs << "x, " << std::setprecision(1) << frameStats.frameCount * 1000.0 / totalMs << " frames/s" << std::endl;
+	}
+
+	vkDeviceWaitIdle(device);
+
+	cleanup();
+}
+
 void HelloTriangleApplication::initWindow()
 {
 	glfwInit(); // initialize GLFW library
@@ -92,67 +334,125 @@ void HelloTriangleApplication::initWindow()
 
 void HelloTriangleApplication::initVulkan()
 {
-	createInstance();
+	startupTimeline.time("instance", true, [this]()
+	{
+		createInstance();
+		setupDebugMessenger();
+		createSurface();
+	});
 
-	setupDebugMessenger();
+	startupTimeline.time("device", true, [this]()
+	{
+		pickPhysicalDevice();
+		createLogicalDevice();
+		createMemoryAllocator();
+	});
 
-	createSurface();
+	startupTimeline.time("swap chain", true, [this]()
+	{
+		createSwapChain();
+		createImageViews();
+		createRenderPass();
+		createDescriptorSetLayout();
+	});
 
-	pickPhysicalDevice();
+	// the SPIR-V was read on a worker meanwhile
+	shaderLoad.get();
 
-	createLogicalDevice();
+	// full precision vertex input until the model is in, see swapInModel()
+	startupTimeline.time("graphics pipeline", true, [this]() { createGraphicsPipeline(); }, shaderLoadStage);
 
-	createSwapChain();
+	startupTimeline.time("framebuffers", true, [this]()
+	{
+		createColorResources();
+		createDepthResources();
 
-	createImageViews();
+		createFramebuffers();
+	});
 
-	createRenderPass();
+	// frames are presented with the placeholders until pollAssetLoading() swaps the real assets in
+	startupTimeline.time("placeholders", true, [this]()
+	{
+		createCommandPool();
+		createUploadBatch();
 
-	createDescriptorSetLayout();
+		createDepthResources();
 
-	createGraphicsPipeline();
+		uploadBatch.begin();
+		createPlaceholderTexture();
+		createPlaceholderModel();
+		createInstanceBuffer();
+		uploadBatch.end();
 
-	createColorResources();
-	createDepthResources();
+		createTextureImageView(); 
+		createTextureSampler();
+	});
 
-	createFramebuffers();
+	startupTimeline.time("frame resources", true, [this]()
+	{
+		createUniformBuffers();
+		createLodDrawBuffers();
 
-	createCommandPool();
+		createDescriptorPool();
+		createDescriptorSets();
 
-	createDepthResources();
+		createCommandBuffers();
 
-	createTextureImage(); 
-	createTextureImageView(); 
-	createTextureSampler();
+		createSyncObjects();
+	});
+}
 
-	loadModel();
+void HelloTriangleApplication::mainLoop()
+{
+	bool firstFrame = true;
 
-	createVertexBuffer();
-	createIndexBuffer();
-	createUniformBuffers();
+	while (glfwWindowShouldClose(window) == false) // glfw window loop + render loop
+	{
+		glfwPollEvents();
 
-	createDescriptorPool();
-	createDescriptorSets();
+		pollAssetLoading();
 
-	createCommandBuffers();
+		if (firstFrame == true)
+		{
+			startupTimeline.time("first frame", true, [this]() { drawFrame(); });
+			firstFrame = false;
+		}
+		else
+			drawFrame();
+	}
 
-	createSyncObjects();
+	vkDeviceWaitIdle(device);
 }
 
-void HelloTriangleApplication::mainLoop()
+double HelloTriangleApplication::measureFrames(uint32_t _frameCount)
 {
-	while (glfwWindowShouldClose(window) == false) // glfw window loop + render loop
+	for (uint32_t i = 0; i < FRAME_BENCHMARK_WARMUP_FRAMES && glfwWindowShouldClose(window) == false; i++)
 	{
 		glfwPollEvents();
+		drawFrame();
+	}
 
+	frameStats = FrameStats{};
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	for (uint32_t i = 0; i < _frameCount && glfwWindowShouldClose(window) == false; i++)
+	{
+		glfwPollEvents();
 		drawFrame();
 	}
 
+	// the frames still in flight are part of the throughput
 	vkDeviceWaitIdle(device);
+
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
 }
 
 VkCommandBuffer HelloTriangleApplication::beginSingleTimeCommands()
 {
+	// inside an upload batch, everything is recorded into its command buffer
+	if (uploadBatch.isOpen() == true)
+		return uploadBatch.record();
+
 	VkCommandBufferAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -179,24 +479,50 @@ void HelloTriangleApplication::cleanup()
 	vkDestroyImageView(device, textureImageView, nullptr);
 
 	vkDestroyImage(device, textureImage, nullptr);
-	vkFreeMemory(device, textureImageMemory, nullptr);
+	memoryAllocator.free(textureImageMemory);
 
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
 	vkDestroyBuffer(device, indexBuffer, nullptr);
-	vkFreeMemory(device, indexBufferMemory, nullptr);
+	memoryAllocator.free(indexBufferMemory);
 
 	vkDestroyBuffer(device, vertexBuffer, nullptr); 
-	vkFreeMemory(device, vertexBufferMemory, nullptr);
+	memoryAllocator.free(vertexBufferMemory);
+
+	vkDestroyBuffer(device, instanceBuffer, nullptr);
+	memoryAllocator.free(instanceBufferMemory);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) 
+	if (enableInstanceCulling == true && modelReady == true)
 	{
-		vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-		vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-		vkDestroyFence(device, inFlightFences[i], nullptr);
+		vkDestroyPipeline(device, instanceCullingPipeline, nullptr);
+		vkDestroyPipelineLayout(device, instanceCullingPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, instanceCullingDescriptorSetLayout, nullptr);
+	}
+
+	if (enableMeshletCulling == true && modelReady == true)
+	{
+		vkDestroyPipeline(device, cullingPipeline, nullptr);
+		vkDestroyPipelineLayout(device, cullingPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, cullingDescriptorSetLayout, nullptr);
+
+		vkDestroyBuffer(device, meshletBuffer, nullptr);
+		memoryAllocator.free(meshletBufferMemory);
+		vkDestroyBuffer(device, meshletVertexBuffer, nullptr);
+		memoryAllocator.free(meshletVertexBufferMemory);
+		vkDestroyBuffer(device, meshletTriangleBuffer, nullptr);
+		memoryAllocator.free(meshletTriangleBufferMemory);
 	}
 
+	cleanupSyncObjects();
+	cleanupCommandBuffers();
+
+	uploadBatch.destroy();
+
 	vkDestroyCommandPool(device, commandPool, nullptr);
+	if (transferQueue != VK_NULL_HANDLE)
+		vkDestroyCommandPool(device, transferCommandPool, nullptr);
+
+	memoryAllocator.destroy();
 
 	vkDestroyDevice(device, nullptr);
 
@@ -215,17 +541,15 @@ void HelloTriangleApplication::cleanupSwapChain()
 {
 	vkDestroyImageView(device, colorImageView, nullptr);
 	vkDestroyImage(device, colorImage, nullptr);
-	vkFreeMemory(device, colorImageMemory, nullptr);
+	memoryAllocator.free(colorImageMemory);
 
 	vkDestroyImageView(device, depthImageView, nullptr);
 	vkDestroyImage(device, depthImage, nullptr);
-	vkFreeMemory(device, depthImageMemory, nullptr);
+	memoryAllocator.free(depthImageMemory);
 
 	for (size_t i = 0; i < swapChainFramebuffers.size(); i++) 
 		vkDestroyFramebuffer(device, swapChainFramebuffers[i], nullptr);
 
-	vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-
 	vkDestroyPipeline(device, graphicsPipeline, nullptr);
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyRenderPass(device, renderPass, nullptr);
@@ -235,16 +559,83 @@ void HelloTriangleApplication::cleanupSwapChain()
 
 	vkDestroySwapchainKHR(device, swapChain, nullptr);
 
-	for (size_t i = 0; i < swapChainImages.size(); i++) 
+	vkDestroyBuffer(device, uniformRingBuffer, nullptr);
+	memoryAllocator.free(uniformRingBufferMemory);
+
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+
+	for (size_t i = 0; i < lodDrawBuffers.size(); i++)
 	{
-		vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-		vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+		vkDestroyBuffer(device, lodDrawBuffers[i], nullptr);
+		memoryAllocator.free(lodDrawBuffersMemory[i]);
 	}
 
-	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	for (size_t i = 0; i < streamingDrawBuffers.size(); i++)
+	{
+		vkDestroyBuffer(device, streamingDrawBuffers[i], nullptr);
+		memoryAllocator.free(streamingDrawBuffersMemory[i]);
+	}
+
+	if (enableMeshletCulling == true && modelReady == true)
+	{
+		for (size_t i = 0; i < culledIndexBuffers.size(); i++)
+		{
+			vkDestroyBuffer(device, culledIndexBuffers[i], nullptr);
+			memoryAllocator.free(culledIndexBuffersMemory[i]);
+			vkDestroyBuffer(device, indirectDrawBuffers[i], nullptr);
+			memoryAllocator.free(indirectDrawBuffersMemory[i]);
+		}
+
+		vkDestroyDescriptorPool(device, cullingDescriptorPool, nullptr);
+	}
+
+	if (enableInstanceCulling == true && modelReady == true)
+	{
+		for (size_t i = 0; i < instanceDrawBuffers.size(); i++)
+		{
+			vkDestroyBuffer(device, instanceLodBuffers[i], nullptr);
+			memoryAllocator.free(instanceLodBuffersMemory[i]);
+			vkDestroyBuffer(device, culledInstanceBuffers[i], nullptr);
+			memoryAllocator.free(culledInstanceBuffersMemory[i]);
+			vkDestroyBuffer(device, instanceDrawBuffers[i], nullptr);
+			memoryAllocator.free(instanceDrawBuffersMemory[i]);
+		}
+
+		vkDestroyDescriptorPool(device, instanceCullingDescriptorPool, nullptr);
+	}
+}
+
+void HelloTriangleApplication::cleanupCommandBuffers()
+{
+	// destroying a pool frees its command buffers
+	for (size_t i = 0; i < frameCommandPools.size(); i++)
+		vkDestroyCommandPool(device, frameCommandPools[i], nullptr);
+	for (size_t i = 0; i < recordingCommandPools.size(); i++)
+		vkDestroyCommandPool(device, recordingCommandPools[i], nullptr);
+
+	frameCommandPools.clear();
+	commandBuffers.clear();
+	recordingCommandPools.clear();
+	recordingCommandBuffers.clear();
+}
+
+void HelloTriangleApplication::cleanupSyncObjects()
+{
+	for (size_t i = 0; i < inFlightFences.size(); i++) 
+	{
+		vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
+		vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+		vkDestroyFence(device, inFlightFences[i], nullptr);
+	}
+
+	if (timestampQueryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(device, timestampQueryPool, nullptr);
+		timestampQueryPool = VK_NULL_HANDLE;
+	}
 }
 
-void HelloTriangleApplication::createBuffer(VkDeviceSize _size, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _properties, VkBuffer& _buffer, VkDeviceMemory& _bufferMemory)
+void HelloTriangleApplication::createBuffer(VkDeviceSize _size, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _properties, VkBuffer& _buffer, DeviceAllocation& _bufferMemory)
 {
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -258,15 +649,9 @@ void HelloTriangleApplication::createBuffer(VkDeviceSize _size, VkBufferUsageFla
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(device, _buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, _properties);
+	_bufferMemory = memoryAllocator.allocate(memRequirements, findMemoryType(memRequirements.memoryTypeBits, _properties), false);
 
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &_bufferMemory) != VK_SUCCESS)
-		throw std::runtime_error("failed to allocate vertex buffer memory!");
-
-	vkBindBufferMemory(device, _buffer, _bufferMemory, 0);
+	vkBindBufferMemory(device, _buffer, _bufferMemory.memory, _bufferMemory.offset);
 }
 
 void HelloTriangleApplication::createColorResources()
@@ -280,66 +665,57 @@ void HelloTriangleApplication::createColorResources()
 
 void HelloTriangleApplication::createCommandBuffers()
 {
-	// resize as framebuffers size
-	commandBuffers.resize(swapChainFramebuffers.size());
+	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = commandPool;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+	// a pool per frame in flight, reset as a whole before the frame's command buffer is recorded again
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
-	if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
-		throw std::runtime_error("failed to allocate command buffers!");
+	frameCommandPools.resize(framesInFlight);
+	commandBuffers.resize(framesInFlight);
 
-	for (size_t i = 0; i < commandBuffers.size(); i++) 
+	for (size_t i = 0; i < framesInFlight; i++)
 	{
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0; // Optional
-		beginInfo.pInheritanceInfo = nullptr; // Optional
-
-		// begin recording command buffer
-		if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) 
-			throw std::runtime_error("failed to begin recording command buffer!");
-
-		// record begin render pass for drawing
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = renderPass;
-		renderPassInfo.framebuffer = swapChainFramebuffers[i];
-		renderPassInfo.renderArea.offset = { 0, 0 };
-		renderPassInfo.renderArea.extent = swapChainExtent;
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &frameCommandPools[i]) != VK_SUCCESS)
+			throw std::runtime_error("failed to create frame command pool!");
 
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
-		clearValues[1].depthStencil = { 1.0f, 0 };
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = frameCommandPools[i];
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
 
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
-
-		vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		// bind with graphics pipeline
-		vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+		if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffers[i]) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate command buffers!");
+	}
 
-		VkBuffer vertexBuffers[] = { vertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	// and per recording slot of every frame, a pool and secondary command buffer only that slot's job records into
+	recordingSlotCount = threadPool.getThreadCount() + 1;
+	if (enableParallelRecording == false)
+		recordingThreadCount = 1;
+	else if (RECORDING_THREAD_COUNT == 0)
+		recordingThreadCount = recordingSlotCount;
+	else
+		recordingThreadCount = std::min(RECORDING_THREAD_COUNT, recordingSlotCount);
 
-		// bind descriptor set for each swap chain
-		vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+	recordingCommandPools.resize(framesInFlight * recordingSlotCount);
+	recordingCommandBuffers.resize(framesInFlight * recordingSlotCount);
 
-		// command draw
-		vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+	for (size_t i = 0; i < recordingCommandPools.size(); i++)
+	{
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &recordingCommandPools[i]) != VK_SUCCESS)
+			throw std::runtime_error("failed to create recording command pool!");
 
-		// end render pass
-		vkCmdEndRenderPass(commandBuffers[i]);
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = recordingCommandPools[i];
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
 
-		// finish recording command buffer
-		if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) 
-			throw std::runtime_error("failed to record command buffer!");
+		if (vkAllocateCommandBuffers(device, &allocInfo, &recordingCommandBuffers[i]) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate secondary command buffers!");
 	}
 }
 
@@ -354,21 +730,146 @@ void HelloTriangleApplication::createCommandPool()
 
 	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) 
 		throw std::runtime_error("failed to create command pool!");
+
+	if (transferQueue != VK_NULL_HANDLE)
+	{
+		poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // one command buffer per upload batch
+
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create transfer command pool!");
+	}
+}
+
+void HelloTriangleApplication::createCullingPipeline()
+{
+	// 0 : culling ubo, 1 - 3 : meshlets, 4 : culled indices, 5 : indirect draw command
+	std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = (i == 0) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullingDescriptorSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create culling descriptor set layout!");
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &cullingDescriptorSetLayout;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullingPipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create culling pipeline layout!");
+
+	VkShaderModule computeShaderModule = createShaderModule(cullShaderCode);
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = computeShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = cullingPipelineLayout;
+
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &cullingPipeline) != VK_SUCCESS)
+		throw std::runtime_error("failed to create culling pipeline!");
+
+	vkDestroyShaderModule(device, computeShaderModule, nullptr);
+}
+
+void HelloTriangleApplication::createCullingResources()
+{
+	const size_t frameCount = framesInFlight;
+
+	culledIndexBuffers.resize(frameCount);
+	culledIndexBuffersMemory.resize(frameCount);
+	indirectDrawBuffers.resize(frameCount);
+	indirectDrawBuffersMemory.resize(frameCount);
+
+	// every meshlet visible : all of LOD 0
+	const VkDeviceSize culledIndexBufferSize = sizeof(uint32_t) * lods[0].indexCount;
+
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		createBuffer(culledIndexBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, culledIndexBuffers[i], culledIndexBuffersMemory[i]);
+		createBuffer(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indirectDrawBuffers[i], indirectDrawBuffersMemory[i]);
+	}
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(frameCount);
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(frameCount * 5);
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = static_cast<uint32_t>(frameCount);
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &cullingDescriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("failed to create culling descriptor pool!");
+
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, cullingDescriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = cullingDescriptorPool;
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(frameCount);
+	allocInfo.pSetLayouts = layouts.data();
+
+	cullingDescriptorSets.resize(frameCount);
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, cullingDescriptorSets.data()) != VK_SUCCESS)
+		throw std::runtime_error("failed to allocate culling descriptor sets!");
+
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		std::array<VkDescriptorBufferInfo, 6> bufferInfos{};
+		bufferInfos[0] = { uniformRing.getBuffer(), 0, sizeof(CullingUniformObject) };
+		bufferInfos[1] = { meshletBuffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[2] = { meshletVertexBuffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[3] = { meshletTriangleBuffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[4] = { culledIndexBuffers[i], 0, VK_WHOLE_SIZE };
+		bufferInfos[5] = { indirectDrawBuffers[i], 0, VK_WHOLE_SIZE };
+
+		std::array<VkWriteDescriptorSet, 6> descriptorWrites{};
+		for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++)
+		{
+			descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[binding].dstSet = cullingDescriptorSets[i];
+			descriptorWrites[binding].dstBinding = binding;
+			descriptorWrites[binding].dstArrayElement = 0;
+			descriptorWrites[binding].descriptorType = (binding == 0) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[binding].descriptorCount = 1;
+			descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
 }
 
 void HelloTriangleApplication::createDescriptorPool()
 {
 	std::array<VkDescriptorPoolSize, 2> poolSizes{};
-	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSizes[0].descriptorCount = framesInFlight;
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+	poolSizes[1].descriptorCount = framesInFlight;
 
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+	poolInfo.maxSets = framesInFlight;
 
 	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) 
 		throw std::runtime_error("failed to create descriptor pool!");
@@ -378,7 +879,7 @@ void HelloTriangleApplication::createDescriptorSetLayout()
 {
 	VkDescriptorSetLayoutBinding uboLayoutBinding{};
 	uboLayoutBinding.binding = 0;
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uboLayoutBinding.descriptorCount = 1;
 	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
@@ -403,15 +904,15 @@ void HelloTriangleApplication::createDescriptorSetLayout()
 
 void HelloTriangleApplication::createDescriptorSets()
 {
-	std::vector<VkDescriptorSetLayout> layouts(swapChainImages.size(), descriptorSetLayout);
+	std::vector<VkDescriptorSetLayout> layouts(framesInFlight, descriptorSetLayout);
 
 	VkDescriptorSetAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.descriptorPool = descriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
+	allocInfo.descriptorSetCount = framesInFlight;
 	allocInfo.pSetLayouts = layouts.data();
 
-	descriptorSets.resize(swapChainImages.size());
+	descriptorSets.resize(framesInFlight);
 
 	if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) 
 		throw std::runtime_error("failed to allocate descriptor sets!");
@@ -419,10 +920,11 @@ void HelloTriangleApplication::createDescriptorSets()
 	// descriptorSets don't need to free,
 	// automatically freed when the descriptor pool is destroyed.
 
-	for (size_t i = 0; i < swapChainImages.size(); i++) 
+	for (size_t i = 0; i < descriptorSets.size(); i++) 
 	{
 		VkDescriptorBufferInfo bufferInfo{};
-		bufferInfo.buffer = uniformBuffers[i];
+		// the dynamic offset bound with the set picks the frame's region
+		bufferInfo.buffer = uniformRing.getBuffer();
 		bufferInfo.offset = 0;
 		bufferInfo.range = sizeof(UniformBufferObject);
 
@@ -437,7 +939,7 @@ void HelloTriangleApplication::createDescriptorSets()
 		descriptorWrites[0].dstSet = descriptorSets[i];
 		descriptorWrites[0].dstBinding = 0;
 		descriptorWrites[0].dstArrayElement = 0;
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		descriptorWrites[0].descriptorCount = 1;
 		descriptorWrites[0].pBufferInfo = &bufferInfo;
 
@@ -454,6 +956,18 @@ void HelloTriangleApplication::createDescriptorSets()
 	}
 }
 
+void HelloTriangleApplication::createDeviceLocalBuffer(const void* _data, VkDeviceSize _size, VkBufferUsageFlags _usage, VkPipelineStageFlags _dstStage, VkAccessFlags _dstAccess, VkBuffer& _buffer, DeviceAllocation& _bufferMemory)
+{
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	memcpy(stageUpload(_size, stagingBuffer, stagingOffset), _data, (size_t)_size);
+
+	createBuffer(_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | _usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _buffer, _bufferMemory);
+
+	copyBuffer(stagingBuffer, stagingOffset, _buffer, _size);
+	uploadBatch.handOverBuffer(_buffer, 0, _size, _dstStage, _dstAccess);
+}
+
 void HelloTriangleApplication::createFramebuffers()
 {
 	// resize as image view size
@@ -478,12 +992,44 @@ void HelloTriangleApplication::createFramebuffers()
 	}
 }
 
-void HelloTriangleApplication::createGraphicsPipeline()
+void HelloTriangleApplication::createGeometryPool()
 {
-	// shader stage
-	std::vector<char> vertShaderCode = readFile("shaders/vert.spv");
-	std::vector<char> fragShaderCode = readFile("shaders/frag.spv");
+	const ChunkedMeshView chunks = getModelChunks();
+	if (chunks.chunkCount == 0)
+		throw std::runtime_error("failed to stream geometry, the model has no chunks!");
+
+	// every slot fits the largest chunk
+	geometrySlotVertexCount = 0;
+	geometrySlotIndexCount = 0;
+	for (size_t i = 0; i < chunks.chunkCount; i++)
+	{
+		geometrySlotVertexCount = std::max(geometrySlotVertexCount, chunks.chunks[i].vertexCount);
+		geometrySlotIndexCount = std::max(geometrySlotIndexCount, chunks.chunks[i].indexCount);
+	}
+
+	const VkDeviceSize vertexSize = (useCompactVertices == true) ? sizeof(CompactVertex) : sizeof(Vertex);
+	geometrySlotSize = vertexSize * geometrySlotVertexCount + sizeof(uint16_t) * geometrySlotIndexCount;
+
+	// no more slots than chunks when the whole model fits
+	const VkDeviceSize slotCount = std::max<VkDeviceSize>(1, std::min<VkDeviceSize>(chunks.chunkCount, GEOMETRY_POOL_SIZE / geometrySlotSize));
+	geometryPool.reset(static_cast<uint32_t>(slotCount), chunks.chunkCount);
+	streamingFrame = 0;
+
+	// split streams : a slot's positions and attributes start at the same vertex of their stream
+	createBuffer(vertexSize * geometrySlotVertexCount * slotCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+	if (enableSplitVertexStreams == true)
+		vertexAttributeStreamOffset = ((useCompactVertices == true) ? VertexStreams<CompactVertex>::POSITION_SIZE : VertexStreams<Vertex>::POSITION_SIZE) * geometrySlotVertexCount * slotCount;
 
+	// chunk local indices always fit in 16 bits
+	indexType = VK_INDEX_TYPE_UINT16;
+	createBuffer(sizeof(uint16_t) * geometrySlotIndexCount * slotCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+
+	std::cout << "geometry streaming : " << chunks.chunkCount << " chunks, " << slotCount << " slots of " << geometrySlotSize / 1024 << " KB" << std::endl;
+}
+
+void HelloTriangleApplication::createGraphicsPipeline()
+{
+	// shader stage, the code was read by startAssetLoading()
 	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
 	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
 
@@ -501,15 +1047,16 @@ void HelloTriangleApplication::createGraphicsPipeline()
 
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescriptions = Vertex::getAttributeDescriptions();
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+	getVertexInputDescriptions(bindingDescriptions, attributeDescriptions);
 
 	// vertex input (bindings, attribute)
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
 	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 	// topology
@@ -733,15 +1280,198 @@ void HelloTriangleApplication::createInstance()
 		throw std::runtime_error("Failed to create instance!");
 }
 
-void HelloTriangleApplication::createLogicalDevice()
+void HelloTriangleApplication::createInstanceBuffer()
 {
-	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
-
-	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+	std::vector<InstanceData> instances;
 
-	float queuePriority = 1.0f;
-	for (uint32_t queueFamily : uniqueQueueFamilies)
+	if (enableInstancing == true)
+	{
+		// square grid centered on the origin in the xy plane, z up like the camera
+		const uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(INSTANCE_COUNT))));
+		const float gridOffset = (gridSize - 1) * INSTANCE_SPACING * 0.5f;
+
+		// fixed seed, every run draws the same scene
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> angleDistribution(0.0f, glm::radians(360.0f));
+		std::uniform_real_distribution<float> scaleDistribution(0.6f, 1.0f);
+
+		instances.resize(INSTANCE_COUNT);
+		for (uint32_t i = 0; i < INSTANCE_COUNT; i++)
+		{
+			const float x = (i % gridSize) * INSTANCE_SPACING - gridOffset;
+			const float y = (i / gridSize) * INSTANCE_SPACING - gridOffset;
+			const float halfAngle = angleDistribution(random) * 0.5f;
+
+			instances[i].positionScale = glm::vec4(x, y, 0.0f, scaleDistribution(random));
+			instances[i].rotation = glm::vec4(0.0f, 0.0f, std::sin(halfAngle), std::cos(halfAngle)); // around z
+		}
+
+		instanceGridRadius = std::sqrt(2.0f) * gridOffset;
+	}
+	else
+	{
+		instances.resize(1);
+		instances[0].positionScale = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		instances[0].rotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		instanceGridRadius = 0.0f;
+	}
+
+	instanceCount = static_cast<uint32_t>(instances.size());
+
+	// the placeholder draws it directly, the loaded model through the instance culling pass
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+	VkAccessFlags dstAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	if (enableInstanceCulling == true)
+	{
+		usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		dstStage |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dstAccess |= VK_ACCESS_SHADER_READ_BIT;
+	}
+
+	createDeviceLocalBuffer(instances.data(), sizeof(InstanceData) * instances.size(), usage, dstStage, dstAccess, instanceBuffer, instanceBufferMemory);
+}
+
+void HelloTriangleApplication::createInstanceCullingPipeline()
+{
+	// 0 : culling ubo, 1 : instances, 2 : instance LODs, 3 : culled instances, 4 : draws
+	std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = (i == 0) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &instanceCullingDescriptorSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create instance culling descriptor set layout!");
+
+	// which of the two passes runs
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(uint32_t);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &instanceCullingDescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &instanceCullingPipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create instance culling pipeline layout!");
+
+	VkShaderModule computeShaderModule = createShaderModule(instanceCullShaderCode);
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = computeShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = instanceCullingPipelineLayout;
+
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &instanceCullingPipeline) != VK_SUCCESS)
+		throw std::runtime_error("failed to create instance culling pipeline!");
+
+	vkDestroyShaderModule(device, computeShaderModule, nullptr);
+}
+
+void HelloTriangleApplication::createInstanceCullingResources()
+{
+	const size_t frameCount = framesInFlight;
+
+	instanceCullingLodCount = std::min(static_cast<uint32_t>(lods.size()), INSTANCE_CULLING_MAX_LOD_COUNT);
+
+	instanceLodBuffers.resize(frameCount);
+	instanceLodBuffersMemory.resize(frameCount);
+	culledInstanceBuffers.resize(frameCount);
+	culledInstanceBuffersMemory.resize(frameCount);
+	instanceDrawBuffers.resize(frameCount);
+	instanceDrawBuffersMemory.resize(frameCount);
+
+	// every instance visible
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		createBuffer(sizeof(uint32_t) * instanceCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, instanceLodBuffers[i], instanceLodBuffersMemory[i]);
+		createBuffer(sizeof(InstanceData) * instanceCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, culledInstanceBuffers[i], culledInstanceBuffersMemory[i]);
+		createBuffer(sizeof(InstanceCullingDraws), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, instanceDrawBuffers[i], instanceDrawBuffersMemory[i]);
+	}
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(frameCount);
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(frameCount * 4);
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = static_cast<uint32_t>(frameCount);
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &instanceCullingDescriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("failed to create instance culling descriptor pool!");
+
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, instanceCullingDescriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = instanceCullingDescriptorPool;
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(frameCount);
+	allocInfo.pSetLayouts = layouts.data();
+
+	instanceCullingDescriptorSets.resize(frameCount);
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, instanceCullingDescriptorSets.data()) != VK_SUCCESS)
+		throw std::runtime_error("failed to allocate instance culling descriptor sets!");
+
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		std::array<VkDescriptorBufferInfo, 5> bufferInfos{};
+		bufferInfos[0] = { uniformRing.getBuffer(), 0, sizeof(InstanceCullingUniformObject) };
+		bufferInfos[1] = { instanceBuffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[2] = { instanceLodBuffers[i], 0, VK_WHOLE_SIZE };
+		bufferInfos[3] = { culledInstanceBuffers[i], 0, VK_WHOLE_SIZE };
+		bufferInfos[4] = { instanceDrawBuffers[i], 0, VK_WHOLE_SIZE };
+
+		std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+		for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++)
+		{
+			descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[binding].dstSet = instanceCullingDescriptorSets[i];
+			descriptorWrites[binding].dstBinding = binding;
+			descriptorWrites[binding].dstArrayElement = 0;
+			descriptorWrites[binding].descriptorType = (binding == 0) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[binding].descriptorCount = 1;
+			descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void HelloTriangleApplication::createLogicalDevice()
+{
+	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+
+	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+
+	const bool useTransferQueue = (enableTransferQueue == true && indices.transferFamily.has_value() == true);
+	if (useTransferQueue == true)
+		uniqueQueueFamilies.insert(indices.transferFamily.value());
+
+	float queuePriority = 1.0f;
+	for (uint32_t queueFamily : uniqueQueueFamilies)
 	{
 		VkDeviceQueueCreateInfo queueCreateInfo{};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
@@ -756,6 +1486,38 @@ void HelloTriangleApplication::createLogicalDevice()
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
 	deviceFeatures.sampleRateShading = VK_TRUE; // enable sample shading feature for the device
 
+	// lets the streamed chunks be drawn with one indirect call
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	multiDrawIndirect = (supportedFeatures.multiDrawIndirect == VK_TRUE);
+
+	// lets the instance culling pass decide how many of its draws are issued (core only from vulkan 1.2)
+	std::vector<const char*> enabledExtensions = deviceExtensions;
+	bool drawIndirectCount = false;
+	if (enableInstanceCulling == true)
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions)
+		{
+			if (strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+				drawIndirectCount = true;
+		}
+
+		if (drawIndirectCount == true)
+			enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+		// each LOD's draw starts at its first culled instance
+		if (supportedFeatures.drawIndirectFirstInstance == VK_FALSE)
+			throw std::runtime_error("instance culling needs the drawIndirectFirstInstance feature!");
+		deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	}
+
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -772,14 +1534,62 @@ void HelloTriangleApplication::createLogicalDevice()
 		createInfo.enabledLayerCount = 0;
 
 	// device extension
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS)
 		throw std::runtime_error("failed to create logical device!");
 
+	if (drawIndirectCount == true)
+		cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+
 	vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
 	vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+	if (useTransferQueue == true)
+	{
+		vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+		std::cout << "uploads on transfer queue family " << indices.transferFamily.value() << std::endl;
+	}
+}
+
+void HelloTriangleApplication::createPlaceholderModel()
+{
+	// unit cube in the full precision vertex format
+	const std::vector<Vertex> cubeVertices = {
+		{ { -0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		{ {  0.5f, -0.5f, -0.5f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f } },
+		{ {  0.5f,  0.5f, -0.5f }, { 1.0f, 1.0f, 0.0f }, { 1.0f, 1.0f } },
+		{ { -0.5f,  0.5f, -0.5f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f } },
+		{ { -0.5f, -0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } },
+		{ {  0.5f, -0.5f,  0.5f }, { 1.0f, 0.0f, 1.0f }, { 1.0f, 0.0f } },
+		{ {  0.5f,  0.5f,  0.5f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
+		{ { -0.5f,  0.5f,  0.5f }, { 0.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } },
+	};
+
+	// counter clockwise seen from outside
+	const std::vector<uint32_t> cubeIndices = {
+		0, 3, 2, 2, 1, 0, // -z
+		4, 5, 6, 6, 7, 4, // +z
+		0, 1, 5, 5, 4, 0, // -y
+		3, 7, 6, 6, 2, 3, // +y
+		0, 4, 7, 7, 3, 0, // -x
+		1, 2, 6, 6, 5, 1, // +x
+	};
+
+	createVertexBuffer(cubeVertices.data(), cubeVertices.size());
+	createIndexBuffer(cubeIndices.data(), cubeIndices.size(), cubeVertices.size());
+}
+
+void HelloTriangleApplication::createPlaceholderTexture()
+{
+	// single mid grey texel
+	DecodedTexture texture;
+	texture.width = 1;
+	texture.height = 1;
+	texture.pixels = { 128, 128, 128, 255 };
+
+	createTextureImage(texture);
 }
 
 void HelloTriangleApplication::createRenderPass()
@@ -865,12 +1675,20 @@ void HelloTriangleApplication::createRenderPass()
 		throw std::runtime_error("failed to create render pass!");
 }
 
+void HelloTriangleApplication::createStreamingDrawBuffers()
+{
+	streamingDrawBuffers.resize(framesInFlight);
+	streamingDrawBuffersMemory.resize(framesInFlight);
+
+	for (size_t i = 0; i < streamingDrawBuffers.size(); i++)
+		createBuffer(sizeof(VkDrawIndexedIndirectCommand) * geometryPool.getSlotCount(), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, streamingDrawBuffers[i], streamingDrawBuffersMemory[i]);
+}
+
 void HelloTriangleApplication::createSyncObjects()
 {
-	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-	imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
+	imageAvailableSemaphores.resize(framesInFlight);
+	renderFinishedSemaphores.resize(framesInFlight);
+	inFlightFences.resize(framesInFlight);
 
 	VkSemaphoreCreateInfo semaphoreInfo{};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -879,13 +1697,42 @@ void HelloTriangleApplication::createSyncObjects()
 	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	for (size_t i = 0; i < framesInFlight; i++)
 	{
 		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
 			vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
 			vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
 			throw std::runtime_error("failed to create synchronization objects for a frame!");
 	}
+
+	frameTimestampsPending.assign(framesInFlight, false);
+
+	if (frameBenchmark == false)
+		return;
+
+	// GPU frame times, when the graphics queue supports timestamps
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	const uint32_t validBits = queueFamilies[findQueueFamilies(physicalDevice).graphicsFamily.value()].timestampValidBits;
+	if (validBits == 0 || properties.limits.timestampPeriod == 0.0f)
+		return;
+
+	timestampPeriod = properties.limits.timestampPeriod;
+	timestampMask = (validBits >= 64) ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = framesInFlight * 2;
+
+	if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampQueryPool) != VK_SUCCESS)
+		throw std::runtime_error("failed to create timestamp query pool!");
 }
 
 VkShaderModule HelloTriangleApplication::createShaderModule(const std::vector<char>& _code)
@@ -964,86 +1811,165 @@ void HelloTriangleApplication::createSwapChain()
 	swapChainExtent = extent;
 }
 
-void HelloTriangleApplication::createVertexBuffer()
+void HelloTriangleApplication::createUploadBatch()
 {
-	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
+	// owned by the upload batch from now on
 	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	DeviceAllocation stagingBufferMemory;
+	createBuffer(STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+	if (transferQueue != VK_NULL_HANDLE)
+		uploadBatch.create(device, graphicsQueue, queueFamilyIndices.graphicsFamily.value(), commandPool, transferQueue, queueFamilyIndices.transferFamily.value(), transferCommandPool, &memoryAllocator, stagingBuffer, stagingBufferMemory, STAGING_RING_SIZE);
+	else
+		uploadBatch.create(device, graphicsQueue, queueFamilyIndices.graphicsFamily.value(), commandPool, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, &memoryAllocator, stagingBuffer, stagingBufferMemory, STAGING_RING_SIZE);
+}
+
+void HelloTriangleApplication::createVertexBuffer(const Vertex* _vertices, size_t _vertexCount)
+{
+	const Vertex* vertexData = _vertices;
+	size_t vertexCount = _vertexCount;
+
+	const void* uploadData = vertexData;
+	VkDeviceSize bufferSize = sizeof(Vertex) * vertexCount;
 
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	std::vector<CompactVertex> compactVertices;
+	if (useCompactVertices == true)
+	{
+		compactVertices.resize(vertexCount);
+		QuantizeVertices(vertexData, vertexCount, vertexQuantization, compactVertices.data());
+
+		uploadData = compactVertices.data();
+		bufferSize = sizeof(CompactVertex) * vertexCount;
+	}
+
+	// same size, positions first
+	std::vector<char> streams;
+	if (enableSplitVertexStreams == true)
+	{
+		streams.resize((size_t)bufferSize);
+
+		if (useCompactVertices == true)
+		{
+			vertexAttributeStreamOffset = VertexStreams<CompactVertex>::POSITION_SIZE * vertexCount;
+			VertexStreams<CompactVertex>::split(compactVertices.data(), vertexCount, streams.data(), streams.data() + vertexAttributeStreamOffset);
+		}
+		else
+		{
+			vertexAttributeStreamOffset = VertexStreams<Vertex>::POSITION_SIZE * vertexCount;
+			VertexStreams<Vertex>::split(vertexData, vertexCount, streams.data(), streams.data() + vertexAttributeStreamOffset);
+		}
+
+		uploadData = streams.data();
+	}
 
 	// fill data
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, vertices.data(), (size_t)bufferSize);
-	vkUnmapMemory(device, stagingBufferMemory);
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	memcpy(stageUpload(bufferSize, stagingBuffer, stagingOffset), uploadData, (size_t)bufferSize);
 
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
 
-	copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-	// clean up staging buffer
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	copyBuffer(stagingBuffer, stagingOffset, vertexBuffer, bufferSize);
+	uploadBatch.handOverBuffer(vertexBuffer, 0, bufferSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
 }
 
-void HelloTriangleApplication::createIndexBuffer()
+void HelloTriangleApplication::createIndexBuffer(const uint32_t* _indices, size_t _indexCount, size_t _vertexCount)
 {
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+	const uint32_t* indexData = _indices;
+	indexCount = static_cast<uint32_t>(_indexCount);
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	indexType = (enable16BitIndices == true && _vertexCount <= 65536) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+	VkDeviceSize bufferSize = ((indexType == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t)) * indexCount;
 
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices.data(), (size_t)bufferSize);
-	vkUnmapMemory(device, stagingBufferMemory);
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	void* data = stageUpload(bufferSize, stagingBuffer, stagingOffset);
+	if (indexType == VK_INDEX_TYPE_UINT16)
+	{
+		// narrowed straight into the staging buffer
+		uint16_t* narrowIndices = static_cast<uint16_t*>(data);
+		for (uint32_t i = 0; i < indexCount; i++)
+			narrowIndices[i] = static_cast<uint16_t>(indexData[i]);
+	}
+	else
+		memcpy(data, indexData, (size_t)bufferSize);
 
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
 
-	copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+	copyBuffer(stagingBuffer, stagingOffset, indexBuffer, bufferSize);
+	uploadBatch.handOverBuffer(indexBuffer, 0, bufferSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+}
+
+void HelloTriangleApplication::createLodDrawBuffers()
+{
+	lodDrawBuffers.resize(framesInFlight);
+	lodDrawBuffersMemory.resize(framesInFlight);
 
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	for (size_t i = 0; i < lodDrawBuffers.size(); i++)
+		createBuffer(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, lodDrawBuffers[i], lodDrawBuffersMemory[i]);
 }
 
-void HelloTriangleApplication::createTextureImage()
+void HelloTriangleApplication::createMemoryAllocator()
 {
-	// load image
-	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
 
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
 
-	mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+	memoryAllocator.create(device, memoryProperties, properties.limits.bufferImageGranularity);
+}
 
-	if (pixels == nullptr) 
-		throw std::runtime_error("failed to load texture image!");
+void HelloTriangleApplication::createMeshletBuffers()
+{
+	const uint32_t* indexData = (meshCache.isOpen() == true) ? meshCache.getIndices() : indices.data();
 
-	// create buffer for image
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	// built over the optimized index order, so each meshlet is a spatially tight run of triangles
+	MeshletMesh meshletMesh = BuildMeshlets(indexData + lods[0].firstIndex, lods[0].indexCount, getModelVertices(), getModelVertexCount());
+	meshletCount = static_cast<uint32_t>(meshletMesh.meshlets.size());
 
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(device, stagingBufferMemory);
+	size_t coneCount = 0;
+	for (const Meshlet& meshlet : meshletMesh.meshlets)
+	{
+		if (meshlet.cone.w < 1.0f)
+			coneCount++;
+	}
 
-	stbi_image_free(pixels);
+	std::cout << "meshlets : " << meshletCount << " (" << coneCount << " with a backface cone)" << std::endl;
+
+	createDeviceLocalBuffer(meshletMesh.meshlets.data(), sizeof(Meshlet) * meshletMesh.meshlets.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, meshletBuffer, meshletBufferMemory);
+	createDeviceLocalBuffer(meshletMesh.vertices.data(), sizeof(uint32_t) * meshletMesh.vertices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, meshletVertexBuffer, meshletVertexBufferMemory);
+	createDeviceLocalBuffer(meshletMesh.triangles.data(), sizeof(uint32_t) * meshletMesh.triangles.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, meshletTriangleBuffer, meshletTriangleBufferMemory);
+}
+
+void HelloTriangleApplication::createTextureImage(const DecodedTexture& _texture)
+{
+	const unsigned char* pixels = _texture.pixels.data();
+	int texWidth = static_cast<int>(_texture.width);
+	int texHeight = static_cast<int>(_texture.height);
+
+	VkDeviceSize imageSize = texWidth * texHeight * 4;
+
+	mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+
+	// staged before anything is recorded, staging may submit the commands recorded so far
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	memcpy(stageUpload(imageSize, stagingBuffer, stagingOffset), pixels, static_cast<size_t>(imageSize));
 
 	createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
 
 	transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
 
-	copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+	copyBufferToImage(stagingBuffer, stagingOffset, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
 
-	//transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+	// the mipmap blits need the graphics queue
+	uploadBatch.handOverImage(textureImage, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
 
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	//transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
 
 	generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
 }
@@ -1075,13 +2001,13 @@ void HelloTriangleApplication::createTextureSampler()
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f; //static_cast<float>(mipLevels / 2);
-	samplerInfo.maxLod = static_cast<float>(mipLevels);
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE; // the same sampler serves the placeholder and the loaded texture
 
 	if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
 		throw std::runtime_error("failed to create texture sampler!");
 }
 
-void HelloTriangleApplication::createImage(uint32_t _width, uint32_t _height, uint32_t _mipLevels, VkSampleCountFlagBits _numSample, VkFormat _format, VkImageTiling _tiling, VkImageUsageFlags _usage, VkMemoryPropertyFlags _properties, VkImage& _image, VkDeviceMemory& _imageMemory)
+void HelloTriangleApplication::createImage(uint32_t _width, uint32_t _height, uint32_t _mipLevels, VkSampleCountFlagBits _numSample, VkFormat _format, VkImageTiling _tiling, VkImageUsageFlags _usage, VkMemoryPropertyFlags _properties, VkImage& _image, DeviceAllocation& _imageMemory)
 {
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1105,16 +2031,9 @@ void HelloTriangleApplication::createImage(uint32_t _width, uint32_t _height, ui
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(device, _image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, _properties);
-
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &_imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
-	}
+	_imageMemory = memoryAllocator.allocate(memRequirements, findMemoryType(memRequirements.memoryTypeBits, _properties), _tiling == VK_IMAGE_TILING_OPTIMAL);
 
-	vkBindImageMemory(device, _image, _imageMemory, 0);
+	vkBindImageMemory(device, _image, _imageMemory.memory, _imageMemory.offset);
 }
 
 void HelloTriangleApplication::createDepthResources()
@@ -1128,22 +2047,26 @@ void HelloTriangleApplication::createDepthResources()
 
 void HelloTriangleApplication::createUniformBuffers()
 {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
 
-	uniformBuffers.resize(swapChainImages.size());
-	uniformBuffersMemory.resize(swapChainImages.size());
+	// minUniformBufferOffsetAlignment is at most 256, so the regions stay aligned
+	const uint32_t frameCount = framesInFlight;
+	createBuffer(frameCount * UNIFORM_RING_FRAME_SIZE, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformRingBuffer, uniformRingBufferMemory);
 
-	for (size_t i = 0; i < swapChainImages.size(); i++) 
-		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
+	uniformRing.create(uniformRingBuffer, uniformRingBufferMemory.mappedData, frameCount, UNIFORM_RING_FRAME_SIZE, properties.limits.minUniformBufferOffsetAlignment);
+
+	sceneUniformOffsets.assign(frameCount, 0);
+	cullingUniformOffsets.assign(frameCount, 0);
 }
 
-void HelloTriangleApplication::copyBuffer(VkBuffer _srcBuffer, VkBuffer _dstBuffer, VkDeviceSize _size)
+void HelloTriangleApplication::copyBuffer(VkBuffer _srcBuffer, VkDeviceSize _srcOffset, VkBuffer _dstBuffer, VkDeviceSize _size)
 {
 	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
 	// copy buffer command
 	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0; // Optional
+	copyRegion.srcOffset = _srcOffset;
 	copyRegion.dstOffset = 0; // Optional
 	copyRegion.size = _size;
 	vkCmdCopyBuffer(commandBuffer, _srcBuffer, _dstBuffer, 1, &copyRegion);
@@ -1151,12 +2074,12 @@ void HelloTriangleApplication::copyBuffer(VkBuffer _srcBuffer, VkBuffer _dstBuff
 	endSingleTimeCommands(commandBuffer);
 }
 
-void HelloTriangleApplication::copyBufferToImage(VkBuffer _buffer, VkImage _image, uint32_t _width, uint32_t _height)
+void HelloTriangleApplication::copyBufferToImage(VkBuffer _buffer, VkDeviceSize _bufferOffset, VkImage _image, uint32_t _width, uint32_t _height)
 {
 	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
 	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
+	region.bufferOffset = _bufferOffset;
 	region.bufferRowLength = 0;
 	region.bufferImageHeight = 0;
 	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1260,6 +2183,15 @@ bool HelloTriangleApplication::checkValidationLayerSupport()
 	return true;
 }
 
+void HelloTriangleApplication::chooseVertexFormat()
+{
+	vertexQuantization = ComputeVertexQuantization(getModelVertices(), getModelVertexCount());
+	useCompactVertices = (enableVertexQuantization == true && vertexQuantization.texCoordsInUnitRange == true);
+
+	if (enableVertexQuantization == true && useCompactVertices == false)
+		std::cout << "texture coordinates outside [0, 1], using the full precision vertex format" << std::endl;
+}
+
 VkExtent2D HelloTriangleApplication::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& _capabilities)
 {
 	if (_capabilities.currentExtent.width != UINT32_MAX) 
@@ -1283,6 +2215,16 @@ VkExtent2D HelloTriangleApplication::chooseSwapExtent(const VkSurfaceCapabilitie
 
 VkPresentModeKHR HelloTriangleApplication::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& _availablePresentModes)
 {
+	// the frame benchmark measures throughput, not the refresh rate
+	if (frameBenchmark == true)
+	{
+		for (const auto& availablePresentMode : _availablePresentModes)
+		{
+			if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+				return availablePresentMode;
+		}
+	}
+
 	for (const auto& availablePresentMode : _availablePresentModes) 
 	{
 		if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) 
@@ -1309,8 +2251,25 @@ VkSurfaceFormatKHR HelloTriangleApplication::chooseSwapSurfaceFormat(const std::
 
 void HelloTriangleApplication::drawFrame()
 {
+	const auto frameStart = std::chrono::high_resolution_clock::now();
+
+	// the GPU is done with the last use of this frame's resources, the frames after it can still be running
 	vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-	vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+	const auto waitEnd = std::chrono::high_resolution_clock::now();
+	frameStats.waitMs += std::chrono::duration<double, std::milli>(waitEnd - frameStart).count();
+
+	if (timestampQueryPool != VK_NULL_HANDLE && frameTimestampsPending[currentFrame] == true)
+	{
+		uint64_t timestamps[2];
+		if (vkGetQueryPoolResults(device, timestampQueryPool, currentFrame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+		{
+			frameStats.gpuMs += ((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod / 1000000.0;
+			frameStats.gpuFrameCount++;
+		}
+
+		frameTimestampsPending[currentFrame] = false;
+	}
 
 	// get image
 	uint32_t imageIndex;
@@ -1324,15 +2283,11 @@ void HelloTriangleApplication::drawFrame()
 	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
 		throw std::runtime_error("failed to acquire swap chain image!");
 
-	// Check if a previous frame is using this image (i.e. there is its fence to wait on)
-	if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
-		vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+	// uniforms and draws of the current frame, its previous contents aren't read anymore
+	updateUniformBuffer(currentFrame);
 
-	// Mark the image as now being in use by this frame
-	imagesInFlight[imageIndex] = inFlightFences[currentFrame];
-
-	// update uniform buffer for current swap chain image
-	updateUniformBuffer(imageIndex);
+	// recorded every frame, so it always matches the current resources
+	recordCommandBuffer(currentFrame, imageIndex);
 
 	// submitting command buffer
 	VkSubmitInfo submitInfo{};
@@ -1344,17 +2299,21 @@ void HelloTriangleApplication::drawFrame()
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+	submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
 	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
+	// reset only once the submit that signals it again is certain, an early return above would leave it unsignalled
 	vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
 	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
 		throw std::runtime_error("failed to submit draw command buffer!");
 
+	if (timestampQueryPool != VK_NULL_HANDLE)
+		frameTimestampsPending[currentFrame] = true;
+
 	// presentation
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1376,13 +2335,20 @@ void HelloTriangleApplication::drawFrame()
 	else if (result != VK_SUCCESS) 
 		throw std::runtime_error("failed to present swap chain image!");
 
-	vkQueueWaitIdle(presentQueue);
+	// no wait for the queue : the next frames are recorded while this one renders,
+	// until framesInFlight frames are queued and the fence wait above blocks
+	currentFrame = (currentFrame + 1) % framesInFlight;
 
-	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	frameStats.frameCount++;
+	frameStats.cpuMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - waitEnd).count();
 }
 
 void HelloTriangleApplication::endSingleTimeCommands(VkCommandBuffer _commandBuffer)
 {
+	// submitted once by uploadBatch.end()
+	if (uploadBatch.isOpen() == true)
+		return;
+
 	vkEndCommandBuffer(_commandBuffer);
 
 	VkSubmitInfo submitInfo{};
@@ -1433,16 +2399,20 @@ QueueFamilyIndices HelloTriangleApplication::findQueueFamilies(VkPhysicalDevice
 	int i = 0;
 	for (const auto& queueFamily : queueFamilies)
 	{
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && indices.graphicsFamily.has_value() == false)
 			indices.graphicsFamily = i;
 
 		VkBool32 presentSupport = false;
 		vkGetPhysicalDeviceSurfaceSupportKHR(_device, i, surface, &presentSupport);
 
-		if (presentSupport == VK_TRUE)
+		if (presentSupport == VK_TRUE && indices.presentFamily.has_value() == false)
 			indices.presentFamily = i;
 
-		if (indices.isComplete() == true)
+		// transfer only, usually the copy engine that runs beside graphics work
+		if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && (queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0 && indices.transferFamily.has_value() == false)
+			indices.transferFamily = i;
+
+		if (indices.isComplete() == true && indices.transferFamily.has_value() == true)
 			break;
 
 		i++;
@@ -1475,7 +2445,8 @@ void HelloTriangleApplication::generateMipmaps(VkImage _image, VkFormat _imageFo
 	if ((formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) == false) 
 		throw std::runtime_error("texture image format does not support linear blitting!");
 
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	// blits are graphics work, the batch's transfer commands may be on a transfer queue
+	VkCommandBuffer commandBuffer = (uploadBatch.isOpen() == true) ? uploadBatch.recordGraphics() : beginSingleTimeCommands();
 
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -1554,6 +2525,69 @@ void HelloTriangleApplication::generateMipmaps(VkImage _image, VkFormat _imageFo
 	endSingleTimeCommands(commandBuffer);
 }
 
+uint32_t HelloTriangleApplication::getRecordingJobCount() const
+{
+	const uint32_t drawJobCount = (sceneDrawCount + RECORDING_MIN_DRAWS_PER_THREAD - 1) / RECORDING_MIN_DRAWS_PER_THREAD;
+
+	return std::max(std::min(recordingThreadCount, drawJobCount), 1u);
+}
+
+void HelloTriangleApplication::getVertexInputDescriptions(std::vector<VkVertexInputBindingDescription>& _bindingDescriptions, std::vector<VkVertexInputAttributeDescription>& _attributeDescriptions) const
+{
+	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions;
+
+	if (enableSplitVertexStreams == true)
+	{
+		auto bindingDescriptions = (useCompactVertices == true) ? VertexStreams<CompactVertex>::getBindingDescriptions() : VertexStreams<Vertex>::getBindingDescriptions();
+		_bindingDescriptions.assign(bindingDescriptions.begin(), bindingDescriptions.end());
+
+		attributeDescriptions = (useCompactVertices == true) ? VertexStreams<CompactVertex>::getAttributeDescriptions() : VertexStreams<Vertex>::getAttributeDescriptions();
+	}
+	else
+	{
+		_bindingDescriptions.assign(1, (useCompactVertices == true) ? CompactVertex::getBindingDescription() : Vertex::getBindingDescription());
+
+		attributeDescriptions = (useCompactVertices == true) ? CompactVertex::getAttributeDescriptions() : Vertex::getAttributeDescriptions();
+	}
+
+	_attributeDescriptions.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+
+	// instance transforms after the vertex streams, the non instanced shader doesn't read them
+	if (enableInstancing == true)
+	{
+		const uint32_t instanceBinding = static_cast<uint32_t>(_bindingDescriptions.size());
+		_bindingDescriptions.push_back(InstanceData::getBindingDescription(instanceBinding));
+
+		auto instanceAttributeDescriptions = InstanceData::getAttributeDescriptions(instanceBinding);
+		_attributeDescriptions.insert(_attributeDescriptions.end(), instanceAttributeDescriptions.begin(), instanceAttributeDescriptions.end());
+	}
+}
+
+const Vertex* HelloTriangleApplication::getModelVertices() const
+{
+	// warm start : straight from the mapped mesh cache
+	return (meshCache.isOpen() == true) ? meshCache.getVertices() : vertices.data();
+}
+
+size_t HelloTriangleApplication::getModelVertexCount() const
+{
+	return (meshCache.isOpen() == true) ? meshCache.getVertexCount() : vertices.size();
+}
+
+ChunkedMeshView HelloTriangleApplication::getModelChunks() const
+{
+	if (meshCache.isOpen() == true)
+		return meshCache.getChunks();
+
+	ChunkedMeshView view;
+	view.chunks = chunkedMesh.chunks.data();
+	view.chunkCount = chunkedMesh.chunks.size();
+	view.vertices = chunkedMesh.vertices.data();
+	view.indices = chunkedMesh.indices.data();
+
+	return view;
+}
+
 VkSampleCountFlagBits HelloTriangleApplication::getMaxUsableSampleCount()
 {
 	VkPhysicalDeviceProperties physicalDeviceProperties;
@@ -1617,48 +2651,117 @@ bool HelloTriangleApplication::isDeviceSuitable(VkPhysicalDevice _device)
 
 void HelloTriangleApplication::loadModel()
 {
+	// warm start : no parsing or deduplication, the data stays in the mapped cache file
+	if (enableMeshCache == true && meshCache.open(MESH_CACHE_PATH, MODEL_PATH, MeshProcessingKey()) == true)
+	{
+		// a cache written without chunks can't be streamed
+		if (enableGeometryStreaming == false || meshCache.getChunks().chunkCount > 0)
+		{
+			lods.assign(meshCache.getLods(), meshCache.getLods() + meshCache.getLodCount());
+			return;
+		}
+
+		meshCache.close();
+	}
+
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
 	std::string warn, err;
 
-	if (tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str()) == false) 
+	if (enableParallelObjParsing == true)
+	{
+		if (LoadObjParallel(&attrib, &shapes, &warn, &err, MODEL_PATH.c_str(), threadPool) == false)
+			throw std::runtime_error(warn + err);
+	}
+	else if (tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str()) == false) 
 		throw std::runtime_error(warn + err);
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+	size_t cornerCount = 0;
+	for (const auto& shape : shapes)
+		cornerCount += shape.mesh.indices.size();
+
+	// closed meshes share each vertex between ~6 corners, uv seams lower that, so reserve for 1 in 4
+	const size_t expectedVertexCount = cornerCount / 4;
+	indices.reserve(cornerCount);
 
-	for (const auto& shape : shapes) 
+	if (enableIndexDeduplication == true)
 	{
-		for (const auto& index : shape.mesh.indices) 
-		{
-			Vertex vertex{};
+		IndexDeduplicator uniqueCorners(attrib.vertices.size() / 3, expectedVertexCount);
+		VertexDeduplicator uniqueVertices(vertices, expectedVertexCount);
 
-			vertex.pos = {
-				attrib.vertices[3 * index.vertex_index + 0],
-				attrib.vertices[3 * index.vertex_index + 1],
-				attrib.vertices[3 * index.vertex_index + 2]
-			};
+		// key id -> vertex index
+		std::vector<uint32_t> cornerVertices;
+		cornerVertices.reserve(expectedVertexCount);
 
-			vertex.texCoord = {
-				attrib.texcoords[2 * index.texcoord_index + 0],
-				1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-			};
+		for (const auto& shape : shapes)
+		{
+			for (const auto& index : shape.mesh.indices)
+			{
+				bool isNew = false;
+				uint32_t key = uniqueCorners.insert(index, isNew);
 
-			vertex.color = { 1.0f, 1.0f, 1.0f };
+				if (isNew == true)
+					cornerVertices.push_back(uniqueVertices.insert(BuildVertex(attrib, index)));
 
-			if (uniqueVertices.count(vertex) == 0)
-			{
-				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
+				indices.push_back(cornerVertices[key]);
 			}
+		}
+	}
+	else
+	{
+		VertexDeduplicator uniqueVertices(vertices, expectedVertexCount);
 
-			indices.push_back(uniqueVertices[vertex]);
+		for (const auto& shape : shapes)
+		{
+			for (const auto& index : shape.mesh.indices)
+				indices.push_back(uniqueVertices.insert(BuildVertex(attrib, index)));
 		}
 	}
-}
 
-void HelloTriangleApplication::pickPhysicalDevice()
-{
+	if (enableMeshOptimization == true)
+	{
+		VertexCacheStats before = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+		OptimizeVertexCache(indices, vertices.size());
+
+		if (enableOverdrawOptimization == true)
+		{
+			OverdrawStats overdrawBefore = AnalyzeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+			OptimizeOverdraw(indices, vertices);
+			OverdrawStats overdrawAfter = AnalyzeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+
+			std::cout << "overdraw optimization : overdraw " << overdrawBefore.overdraw << " -> " << overdrawAfter.overdraw << std::endl;
+		}
+
+		OptimizeVertexFetch(vertices, indices);
+
+		VertexCacheStats after = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+		std::cout << "vertex cache optimization : ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+	}
+
+	// the levels follow LOD 0 in indices and share the vertices
+	if (enableLodChain == true)
+	{
+		lods = BuildLodChain(indices, vertices, MAX_LOD_COUNT);
+
+		for (size_t i = 0; i < lods.size(); i++)
+			std::cout << "lod " << i << " : " << lods[i].indexCount / 3 << " triangles, error " << lods[i].error << std::endl;
+	}
+	else
+		lods = { MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0.0f } };
+
+	// chunks of the full resolution model, in vertex cache order
+	if (enableGeometryStreaming == true)
+		chunkedMesh = BuildMeshChunks(indices.data() + lods[0].firstIndex, lods[0].indexCount, vertices.data(), vertices.size());
+
+	if (enableMeshCache == true && MeshCache::write(MESH_CACHE_PATH, MODEL_PATH, MeshProcessingKey(), vertices, indices, lods, chunkedMesh) == false)
+		std::cerr << "failed to write mesh cache!" << std::endl;
+}
+
+void HelloTriangleApplication::pickPhysicalDevice()
+{
 	uint32_t deviceCount = 0;
 	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
 
@@ -1682,6 +2785,51 @@ void HelloTriangleApplication::pickPhysicalDevice()
 		throw std::runtime_error("failed to find a suitable GPU!");
 }
 
+void HelloTriangleApplication::pollAssetLoading()
+{
+	const bool textureLoaded = (textureLoad.valid() == true && textureLoad.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+	const bool modelLoaded = (modelLoad.valid() == true && modelLoad.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+
+	if (textureLoaded == false && modelLoaded == false)
+		return;
+
+	vkDeviceWaitIdle(device);
+
+	// the uploads of everything that finished loading share one submit
+	uploadBatch.begin();
+
+	if (textureLoaded == true)
+	{
+		DecodedTexture texture = textureLoad.get(); // rethrows loading errors
+
+		startupTimeline.time("swap in texture", true, [&]() { swapInTexture(texture); }, textureLoadStage);
+	}
+
+	if (modelLoaded == true)
+	{
+		modelLoad.get();
+
+		startupTimeline.time("swap in model", true, [this]() { swapInModel(); }, modelLoadStage);
+	}
+
+	startupTimeline.time("upload", true, [this]()
+	{
+		const uint32_t uploadCount = uploadBatch.end();
+		std::cout << "asset uploads : " << uploadCount << " recorded in one submit" << std::endl;
+
+		const StagingRing& stagingRing = uploadBatch.getStagingRing();
+		std::cout << "staging ring : peak " << stagingRing.getPeakUsedSize() / 1024 << " KB of " << stagingRing.getSize() / 1024 << " KB" << std::endl;
+
+		const DeviceMemoryStats& memoryStats = memoryAllocator.getStats();
+		std::cout << "device memory : " << memoryStats.allocationCount << " allocations of " << memoryStats.requestedBytes / 1024 << " KB in "
+			<< memoryStats.blockCount << " blocks of " << memoryStats.blockBytes / 1024 << " KB and " << memoryStats.dedicatedCount << " dedicated allocations, "
+			<< memoryStats.deviceAllocationCount << " vkAllocateMemory calls" << std::endl;
+	});
+
+	if (enableStartupReport == true && modelLoad.valid() == false && textureLoad.valid() == false)
+		startupTimeline.report(std::cout);
+}
+
 void HelloTriangleApplication::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& _createInfo)
 {
 	_createInfo = {};
@@ -1740,6 +2888,321 @@ int HelloTriangleApplication::rateDeviceSuitability(VkPhysicalDevice _device)
 	return score;
 }
 
+void HelloTriangleApplication::recordCommandBuffer(uint32_t _frame, uint32_t _imageIndex)
+{
+	const auto recordStart = std::chrono::high_resolution_clock::now();
+
+	// the frame's fence has signalled, nothing recorded from the pool is pending anymore
+	vkResetCommandPool(device, frameCommandPools[_frame], 0);
+
+	VkCommandBuffer commandBuffer = commandBuffers[_frame];
+
+	// the placeholder model has no meshlets
+	const bool cullMeshlets = (enableMeshletCulling == true && modelReady == true);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; // re-recorded next time
+	beginInfo.pInheritanceInfo = nullptr; // Optional
+
+	// begin recording command buffer
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) 
+		throw std::runtime_error("failed to begin recording command buffer!");
+
+	if (timestampQueryPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, timestampQueryPool, _frame * 2, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, _frame * 2);
+	}
+
+	if (cullMeshlets == true)
+		recordMeshletCulling(commandBuffer, _frame);
+	if (enableInstanceCulling == true && modelReady == true)
+		recordInstanceCulling(commandBuffer, _frame);
+
+	// record begin render pass for drawing
+	VkRenderPassBeginInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = renderPass;
+	renderPassInfo.framebuffer = swapChainFramebuffers[_imageIndex];
+	renderPassInfo.renderArea.offset = { 0, 0 };
+	renderPassInfo.renderArea.extent = swapChainExtent;
+
+	std::array<VkClearValue, 2> clearValues{};
+	clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+	clearValues[1].depthStencil = { 1.0f, 0 };
+
+	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassInfo.pClearValues = clearValues.data();
+
+	uint32_t drawCount = 0;
+
+	const uint32_t jobCount = getRecordingJobCount();
+	if (jobCount <= 1)
+	{
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		drawCount = recordSceneDraws(commandBuffer, _frame, sceneDrawCount);
+	}
+	else
+	{
+		// the render pass only executes the secondary command buffers the jobs record in parallel
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = swapChainFramebuffers[_imageIndex];
+
+		VkCommandBuffer* secondaryCommandBuffers = &recordingCommandBuffers[_frame * recordingSlotCount];
+		VkCommandPool* secondaryCommandPools = &recordingCommandPools[_frame * recordingSlotCount];
+		std::vector<uint32_t> jobDrawCounts(jobCount);
+
+		threadPool.parallelFor(jobCount, [&](size_t _job)
+		{
+			// each job has its own pool, command pools aren't thread safe
+			vkResetCommandPool(device, secondaryCommandPools[_job], 0);
+
+			VkCommandBufferBeginInfo secondaryBeginInfo{};
+			secondaryBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			secondaryBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			secondaryBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+			if (vkBeginCommandBuffer(secondaryCommandBuffers[_job], &secondaryBeginInfo) != VK_SUCCESS)
+				throw std::runtime_error("failed to begin recording secondary command buffer!");
+
+			// an even share of the scene draws
+			const uint32_t firstDraw = static_cast<uint32_t>(sceneDrawCount * _job / jobCount);
+			const uint32_t endDraw = static_cast<uint32_t>(sceneDrawCount * (_job + 1) / jobCount);
+			jobDrawCounts[_job] = recordSceneDraws(secondaryCommandBuffers[_job], _frame, endDraw - firstDraw);
+
+			if (vkEndCommandBuffer(secondaryCommandBuffers[_job]) != VK_SUCCESS)
+				throw std::runtime_error("failed to record secondary command buffer!");
+		});
+
+		vkCmdExecuteCommands(commandBuffer, jobCount, secondaryCommandBuffers);
+
+		for (uint32_t jobDrawCount : jobDrawCounts)
+			drawCount += jobDrawCount;
+	}
+
+	// end render pass
+	vkCmdEndRenderPass(commandBuffer);
+
+	if (timestampQueryPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, _frame * 2 + 1);
+
+	// finish recording command buffer
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) 
+		throw std::runtime_error("failed to record command buffer!");
+
+	frameStats.recordMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+	frameStats.drawCount += drawCount;
+}
+
+void HelloTriangleApplication::recordInstanceCulling(VkCommandBuffer _commandBuffer, uint32_t _frame)
+{
+	// no visible instances and no draws yet, the draw commands are all rewritten by the compact pass
+	vkCmdFillBuffer(_commandBuffer, instanceDrawBuffers[_frame], 0, offsetof(InstanceCullingDraws, draws), 0);
+
+	VkMemoryBarrier resetBarrier{};
+	resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &resetBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, instanceCullingPipeline);
+	vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, instanceCullingPipelineLayout, 0, 1, &instanceCullingDescriptorSets[_frame], 1, &cullingUniformOffsets[_frame]);
+
+	// 64 instances per workgroup, wrapped into rows of 65535 (the minimum maxComputeWorkGroupCount)
+	const uint32_t groupCount = (instanceCount + 63) / 64;
+	const uint32_t groupCountX = std::min(groupCount, 65535u);
+	const uint32_t groupCountY = (groupCount + 65534) / 65535;
+
+	// classify : frustum test and LOD of every instance, counted per LOD
+	const uint32_t classifyPass = 0;
+	vkCmdPushConstants(_commandBuffer, instanceCullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(classifyPass), &classifyPass);
+	vkCmdDispatch(_commandBuffer, groupCountX, groupCountY, 1);
+
+	VkMemoryBarrier classifyBarrier{};
+	classifyBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	classifyBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	classifyBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &classifyBarrier, 0, nullptr, 0, nullptr);
+
+	// compact : the visible instances grouped by LOD, and the draws
+	const uint32_t compactPass = 1;
+	vkCmdPushConstants(_commandBuffer, instanceCullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(compactPass), &compactPass);
+	vkCmdDispatch(_commandBuffer, groupCountX, groupCountY, 1);
+
+	// culled instances and the draws are read by the draw that follows
+	std::array<VkBufferMemoryBarrier, 2> cullBarriers{};
+	for (auto& barrier : cullBarriers)
+	{
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+	}
+	cullBarriers[0].dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	cullBarriers[0].buffer = culledInstanceBuffers[_frame];
+	cullBarriers[1].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	cullBarriers[1].buffer = instanceDrawBuffers[_frame];
+
+	vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, static_cast<uint32_t>(cullBarriers.size()), cullBarriers.data(), 0, nullptr);
+}
+
+void HelloTriangleApplication::recordMeshletCulling(VkCommandBuffer _commandBuffer, uint32_t _frame)
+{
+	// no triangles yet, one instance
+	VkDrawIndexedIndirectCommand drawCommand{};
+	drawCommand.instanceCount = 1;
+	vkCmdUpdateBuffer(_commandBuffer, indirectDrawBuffers[_frame], 0, sizeof(drawCommand), &drawCommand);
+
+	VkBufferMemoryBarrier resetBarrier{};
+	resetBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	resetBarrier.buffer = indirectDrawBuffers[_frame];
+	resetBarrier.offset = 0;
+	resetBarrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+
+	vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullingPipeline);
+	vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullingPipelineLayout, 0, 1, &cullingDescriptorSets[_frame], 1, &cullingUniformOffsets[_frame]);
+
+	// one workgroup per meshlet, wrapped into rows of 65535 (the minimum maxComputeWorkGroupCount)
+	const uint32_t groupCountX = std::min(meshletCount, 65535u);
+	const uint32_t groupCountY = (meshletCount + 65534) / 65535;
+	vkCmdDispatch(_commandBuffer, groupCountX, groupCountY, 1);
+
+	// culled indices and the draw command are read by the draw that follows
+	std::array<VkBufferMemoryBarrier, 2> cullBarriers{};
+	for (auto& barrier : cullBarriers)
+	{
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+	}
+	cullBarriers[0].dstAccessMask = VK_ACCESS_INDEX_READ_BIT;
+	cullBarriers[0].buffer = culledIndexBuffers[_frame];
+	cullBarriers[1].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	cullBarriers[1].buffer = indirectDrawBuffers[_frame];
+
+	vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, static_cast<uint32_t>(cullBarriers.size()), cullBarriers.data(), 0, nullptr);
+}
+
+uint32_t HelloTriangleApplication::recordSceneDraws(VkCommandBuffer _commandBuffer, uint32_t _frame, uint32_t _sceneDrawCount)
+{
+	// the placeholder model has no meshlets
+	const bool cullMeshlets = (enableMeshletCulling == true && modelReady == true);
+	// and its instances are drawn as they are
+	const bool cullInstances = (enableInstanceCulling == true && modelReady == true);
+
+	// bind with graphics pipeline
+	vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+	// split streams : positions at the start of the buffer, the attribute stream after them
+	VkBuffer vertexBuffers[] = { vertexBuffer, vertexBuffer };
+	VkDeviceSize offsets[] = { 0, vertexAttributeStreamOffset };
+	const uint32_t vertexBindingCount = (enableSplitVertexStreams == true) ? 2 : 1;
+	vkCmdBindVertexBuffers(_commandBuffer, 0, vertexBindingCount, vertexBuffers, offsets);
+
+	// instance transforms at the binding after the vertex streams, see getVertexInputDescriptions()
+	if (enableInstancing == true)
+	{
+		const VkDeviceSize instanceOffset = 0;
+		vkCmdBindVertexBuffers(_commandBuffer, vertexBindingCount, 1, (cullInstances == true) ? &culledInstanceBuffers[_frame] : &instanceBuffer, &instanceOffset);
+	}
+	if (cullMeshlets == true)
+		vkCmdBindIndexBuffer(_commandBuffer, culledIndexBuffers[_frame], 0, VK_INDEX_TYPE_UINT32);
+	else
+		vkCmdBindIndexBuffer(_commandBuffer, indexBuffer, 0, indexType);
+
+	// bind descriptor set of the frame at the scene uniforms updateUniformBuffer() pushed
+	vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[_frame], 1, &sceneUniformOffsets[_frame]);
+
+	// command draw, the culling pass wrote the index count of the surviving meshlets,
+	// updateUniformBuffer() the index range of the selected LOD
+	uint32_t drawCount = 0;
+	for (uint32_t draw = 0; draw < _sceneDrawCount; draw++)
+	{
+		if (modelReady == false)
+		{
+			vkCmdDrawIndexed(_commandBuffer, indexCount, instanceCount, 0, 0, 0); // placeholder
+			drawCount++;
+		}
+		else if (cullMeshlets == true)
+		{
+			vkCmdDrawIndexedIndirect(_commandBuffer, indirectDrawBuffers[_frame], 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+			drawCount++;
+		}
+		else if (cullInstances == true)
+		{
+			// one draw per LOD with visible instances, the culling pass wrote how many
+			const VkDeviceSize drawsOffset = offsetof(InstanceCullingDraws, draws);
+
+			if (cmdDrawIndexedIndirectCount != nullptr)
+			{
+				cmdDrawIndexedIndirectCount(_commandBuffer, instanceDrawBuffers[_frame], drawsOffset, instanceDrawBuffers[_frame], offsetof(InstanceCullingDraws, drawCount), instanceCullingLodCount, sizeof(VkDrawIndexedIndirectCommand));
+				drawCount++;
+			}
+			else if (multiDrawIndirect == true)
+			{
+				// the draws past the count are empty
+				vkCmdDrawIndexedIndirect(_commandBuffer, instanceDrawBuffers[_frame], drawsOffset, instanceCullingLodCount, sizeof(VkDrawIndexedIndirectCommand));
+				drawCount++;
+			}
+			else
+			{
+				for (uint32_t lod = 0; lod < instanceCullingLodCount; lod++)
+					vkCmdDrawIndexedIndirect(_commandBuffer, instanceDrawBuffers[_frame], drawsOffset + lod * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+				drawCount += instanceCullingLodCount;
+			}
+		}
+		else if (enableGeometryStreaming == true)
+		{
+			// one draw per pool slot, updateGeometryStreaming() empties the slots without a visible chunk
+			const uint32_t slotCount = geometryPool.getSlotCount();
+
+			if (multiDrawIndirect == true)
+			{
+				vkCmdDrawIndexedIndirect(_commandBuffer, streamingDrawBuffers[_frame], 0, slotCount, sizeof(VkDrawIndexedIndirectCommand));
+				drawCount++;
+			}
+			else
+			{
+				for (uint32_t slot = 0; slot < slotCount; slot++)
+					vkCmdDrawIndexedIndirect(_commandBuffer, streamingDrawBuffers[_frame], slot * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+				drawCount += slotCount;
+			}
+		}
+		else if (enableLodChain == true)
+		{
+			vkCmdDrawIndexedIndirect(_commandBuffer, lodDrawBuffers[_frame], 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+			drawCount++;
+		}
+		else
+		{
+			vkCmdDrawIndexed(_commandBuffer, lods[0].indexCount, instanceCount, lods[0].firstIndex, 0, 0);
+			drawCount++;
+		}
+	}
+
+	return drawCount;
+}
+
 void HelloTriangleApplication::recreateSwapChain()
 {
 	int width = 0, height = 0;
@@ -1761,9 +3224,32 @@ void HelloTriangleApplication::recreateSwapChain()
 	createDepthResources();
 	createFramebuffers();
 	createUniformBuffers();
+	createLodDrawBuffers();
+	if (enableMeshletCulling == true && modelReady == true)
+		createCullingResources();
+	if (enableInstanceCulling == true && modelReady == true)
+		createInstanceCullingResources();
+	if (enableGeometryStreaming == true && modelReady == true)
+		createStreamingDrawBuffers();
 	createDescriptorPool(); 
 	createDescriptorSets();
+}
+
+void HelloTriangleApplication::setFramesInFlight(uint32_t _framesInFlight)
+{
+	vkDeviceWaitIdle(device);
+
+	cleanupSyncObjects();
+	cleanupCommandBuffers();
+
+	framesInFlight = _framesInFlight;
+	currentFrame = 0;
+
 	createCommandBuffers();
+	createSyncObjects();
+
+	// the per frame resources are created with the swap chain's
+	recreateSwapChain();
 }
 
 void HelloTriangleApplication::setupDebugMessenger()
@@ -1781,6 +3267,136 @@ void HelloTriangleApplication::setupDebugMessenger()
 		throw std::runtime_error("failed to set up debug messenger!");
 }
 
+void* HelloTriangleApplication::stageUpload(VkDeviceSize _size, VkBuffer& _stagingBuffer, VkDeviceSize& _stagingOffset)
+{
+	void* data = uploadBatch.allocateStaging(_size, _stagingBuffer, _stagingOffset);
+	if (data != nullptr)
+		return data;
+
+	// larger than the ring
+	DeviceAllocation stagingBufferMemory;
+	createBuffer(_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _stagingBuffer, stagingBufferMemory);
+
+	data = stagingBufferMemory.mappedData;
+	uploadBatch.releaseBuffer(_stagingBuffer, stagingBufferMemory);
+
+	_stagingOffset = 0;
+	return data;
+}
+
+void HelloTriangleApplication::startAssetLoading()
+{
+	// each task stores its stage before finishing, the future's get() makes it visible to the main thread
+	shaderLoad = threadPool.enqueue([this]()
+	{
+		shaderLoadStage = startupTimeline.time("read shaders", false, [this]()
+		{
+			vertShaderCode = readFile((enableInstancing == true) ? "shaders/instanced_vert.spv" : "shaders/vert.spv");
+			fragShaderCode = readFile("shaders/frag.spv");
+
+			if (enableMeshletCulling == true)
+				cullShaderCode = readFile("shaders/meshlet_cull.spv");
+			if (enableInstanceCulling == true)
+				instanceCullShaderCode = readFile("shaders/instance_cull.spv");
+		});
+	});
+
+	// loadModel() only writes the model members, which the main thread leaves alone until modelLoad is ready
+	modelLoad = threadPool.enqueue([this]()
+	{
+		modelLoadStage = startupTimeline.time("load model", false, [this]() { loadModel(); });
+	});
+
+	textureLoad = threadPool.enqueue([this]()
+	{
+		DecodedTexture texture;
+		textureLoadStage = startupTimeline.time("decode texture", false, [&]() { texture = DecodeTexture(TEXTURE_PATH); });
+		return texture;
+	});
+}
+
+void HelloTriangleApplication::swapInModel()
+{
+	// the pipeline's vertex input depends on the model
+	const bool wasCompact = useCompactVertices;
+	chooseVertexFormat();
+
+	if (useCompactVertices != wasCompact)
+	{
+		vkDestroyPipeline(device, graphicsPipeline, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		createGraphicsPipeline();
+	}
+
+	vkDestroyBuffer(device, indexBuffer, nullptr);
+	memoryAllocator.free(indexBufferMemory);
+	vkDestroyBuffer(device, vertexBuffer, nullptr);
+	memoryAllocator.free(vertexBufferMemory);
+
+	if (enableGeometryStreaming == true)
+	{
+		// the chunks are paged in from the mesh cache (or chunkedMesh) as the camera needs them
+		createGeometryPool();
+		createStreamingDrawBuffers();
+	}
+	else
+	{
+		createVertexBuffer(getModelVertices(), getModelVertexCount());
+		createIndexBuffer((meshCache.isOpen() == true) ? meshCache.getIndices() : indices.data(), (meshCache.isOpen() == true) ? meshCache.getIndexCount() : indices.size(), getModelVertexCount());
+
+		if (enableMeshletCulling == true)
+		{
+			createMeshletBuffers();
+			createCullingPipeline();
+			createCullingResources();
+		}
+
+		if (enableInstanceCulling == true)
+		{
+			createInstanceCullingPipeline();
+			createInstanceCullingResources();
+		}
+
+		meshCache.close(); // everything is on the device now
+	}
+
+	modelReady = true;
+
+	std::cout << "model ready after " << startupTimeline.now() << " ms" << std::endl;
+}
+
+void HelloTriangleApplication::swapInTexture(const DecodedTexture& _texture)
+{
+	vkDestroyImageView(device, textureImageView, nullptr);
+	vkDestroyImage(device, textureImage, nullptr);
+	memoryAllocator.free(textureImageMemory);
+
+	createTextureImage(_texture);
+	createTextureImageView();
+
+	// binding 1 of every set samples the new view
+	for (size_t i = 0; i < descriptorSets.size(); i++)
+	{
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = textureImageView;
+		imageInfo.sampler = textureSampler;
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = descriptorSets[i];
+		descriptorWrite.dstBinding = 1;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	std::cout << "texture ready after " << startupTimeline.now() << " ms" << std::endl;
+}
+
 void HelloTriangleApplication::transitionImageLayout(VkImage _image, VkFormat _format, VkImageLayout _oldLayout, VkImageLayout _newLayout, uint32_t _mipLevels)
 {
 	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
@@ -1849,25 +3465,235 @@ void HelloTriangleApplication::transitionImageLayout(VkImage _image, VkFormat _f
 	endSingleTimeCommands(commandBuffer);
 }
 
-void HelloTriangleApplication::updateUniformBuffer(uint32_t _currentImage)
+void HelloTriangleApplication::updateGeometryStreaming(uint32_t _frame, const glm::mat4& _modelViewProjection, const glm::vec3& _cameraPosition)
+{
+	const ChunkedMeshView chunks = getModelChunks();
+	const uint32_t slotCount = geometryPool.getSlotCount();
+
+	streamingFrame++;
+
+	// the nearest chunks the pool can hold are wanted this frame
+	chunkOrder.resize(chunks.chunkCount);
+	chunkDistances.resize(chunks.chunkCount);
+	for (size_t i = 0; i < chunks.chunkCount; i++)
+	{
+		const glm::vec4& sphere = chunks.chunks[i].boundingSphere;
+
+		chunkOrder[i] = static_cast<uint32_t>(i);
+		chunkDistances[i] = std::max(0.0f, glm::distance(_cameraPosition, glm::vec3(sphere)) - sphere.w);
+	}
+
+	const size_t wantedCount = std::min<size_t>(slotCount, chunks.chunkCount);
+	std::partial_sort(chunkOrder.begin(), chunkOrder.begin() + wantedCount, chunkOrder.end(),
+		[this](uint32_t _a, uint32_t _b) { return chunkDistances[_a] < chunkDistances[_b]; });
+
+	// touch the resident ones first, so the loads below only evict chunks that are no longer wanted
+	for (size_t i = 0; i < wantedCount; i++)
+		geometryPool.touch(chunkOrder[i], streamingFrame);
+
+	// slots the frames in flight may still draw from are not evicted
+	const uint64_t inFlightFrame = (streamingFrame > framesInFlight) ? streamingFrame - framesInFlight : 0;
+
+	std::vector<uint32_t> loads;
+	for (size_t i = 0; i < wantedCount && loads.size() < STREAMING_UPLOADS_PER_FRAME; i++)
+	{
+		if (geometryPool.getSlot(chunkOrder[i]) != GeometryPool::NO_SLOT)
+			continue;
+
+		if (geometryPool.load(chunkOrder[i], streamingFrame, inFlightFrame) == GeometryPool::NO_SLOT)
+			break;
+
+		loads.push_back(chunkOrder[i]);
+	}
+
+	if (loads.empty() == false)
+		uploadGeometryChunks(loads);
+
+	// one draw per slot, empty unless its chunk is wanted and intersects the frustum
+	glm::vec4 frustumPlanes[6];
+	ExtractFrustumPlanes(_modelViewProjection, frustumPlanes);
+
+	VkDrawIndexedIndirectCommand* drawCommands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(streamingDrawBuffersMemory[_frame].mappedData);
+
+	for (uint32_t slot = 0; slot < slotCount; slot++)
+	{
+		VkDrawIndexedIndirectCommand drawCommand{};
+
+		const uint32_t chunk = geometryPool.getChunk(slot);
+		if (chunk != GeometryPool::NO_CHUNK && geometryPool.getLastUse(slot) == streamingFrame)
+		{
+			const glm::vec4& sphere = chunks.chunks[chunk].boundingSphere;
+
+			bool visible = true;
+			for (uint32_t p = 0; p < 6 && visible == true; p++)
+				visible = (glm::dot(glm::vec3(frustumPlanes[p]), glm::vec3(sphere)) + frustumPlanes[p].w >= -sphere.w);
+
+			if (visible == true)
+			{
+				drawCommand.indexCount = chunks.chunks[chunk].indexCount;
+				drawCommand.instanceCount = 1;
+				drawCommand.firstIndex = slot * geometrySlotIndexCount;
+				drawCommand.vertexOffset = static_cast<int32_t>(slot * geometrySlotVertexCount);
+			}
+		}
+
+		drawCommands[slot] = drawCommand;
+	}
+}
+
+void HelloTriangleApplication::updateUniformBuffer(uint32_t _frame)
 {
 	static auto startTime = std::chrono::high_resolution_clock::now();
 
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
+	const glm::mat4 model = glm::rotate(glm::mat4(1.0f), time * glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
 	UniformBufferObject ubo{};
-	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f)); // model mat
-	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)); // view mat
-	ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f); // projection mat
+	ubo.model = model; // model mat
+	if (useCompactVertices == true)
+		ubo.model = ubo.model * vertexQuantization.getDequantizeMatrix();
+	// backed off along the same diagonal until the whole instance grid is in view
+	const float cameraDistance = 2.0f + instanceGridRadius * 1.2f;
+	ubo.view = glm::lookAt(glm::vec3(cameraDistance), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)); // view mat
+	ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f + instanceGridRadius * 4.0f); // projection mat
+
+	// pixels per model space unit at distance 1, before the flip below
+	const float projectionScale = ubo.proj[1][1] * swapChainExtent.height * 0.5f;
 
 	// for vulkan coordination system
 	ubo.proj[1][1] *= -1;
 
-	void* data;
-	vkMapMemory(device, uniformBuffersMemory[_currentImage], 0, sizeof(ubo), 0, &data);
-	memcpy(data, &ubo, sizeof(ubo));
-	vkUnmapMemory(device, uniformBuffersMemory[_currentImage]);
+	// recordCommandBuffer() binds the offsets of these pushes
+	uniformRing.beginFrame(_frame);
+	sceneUniformOffsets[_frame] = uniformRing.push(ubo);
+
+	if (enableLodChain == true && enableMeshletCulling == false && enableGeometryStreaming == false && enableInstanceCulling == false && modelReady == true)
+	{
+		// distance from the camera to the model's bounding sphere, in model space
+		const glm::vec3 cameraPosition = glm::inverse(ubo.view * model)[3];
+		const glm::vec3 center = vertexQuantization.positionMin + vertexQuantization.positionExtent * 0.5f;
+		float distance = glm::length(cameraPosition - center) - glm::length(vertexQuantization.positionExtent) * 0.5f;
+
+		// one LOD for every instance : the one the nearest instance needs, at most a unit scale model at the edge of the grid
+		if (enableInstancing == true)
+			distance = std::max(distance - instanceGridRadius, 0.0f);
+
+		const MeshLod& lod = lods[SelectLod(lods, distance, projectionScale, LOD_MAX_PIXEL_ERROR)];
+
+		VkDrawIndexedIndirectCommand drawCommand{};
+		drawCommand.indexCount = lod.indexCount;
+		drawCommand.instanceCount = instanceCount;
+		drawCommand.firstIndex = lod.firstIndex;
+
+		memcpy(lodDrawBuffersMemory[_frame].mappedData, &drawCommand, sizeof(drawCommand));
+	}
+
+	// chunk bounds are in model space too
+	if (enableGeometryStreaming == true && modelReady == true)
+		updateGeometryStreaming(_frame, ubo.proj * ubo.view * model, glm::inverse(ubo.view * model)[3]);
+
+	if (enableMeshletCulling == true && modelReady == true)
+	{
+		// meshlet bounds are in model space (unquantized), so cull in model space
+		CullingUniformObject culling{};
+		ExtractFrustumPlanes(ubo.proj * ubo.view * model, culling.frustumPlanes);
+		culling.cameraPosition = glm::inverse(ubo.view * model)[3];
+		culling.meshletCount = meshletCount;
+
+		cullingUniformOffsets[_frame] = uniformRing.push(culling);
+	}
+
+	if (enableInstanceCulling == true && modelReady == true)
+	{
+		// instances are culled in world space, around the model's bounding sphere placed by each instance transform
+		InstanceCullingUniformObject culling{};
+		ExtractFrustumPlanes(ubo.proj * ubo.view, culling.frustumPlanes);
+		culling.cameraPosition = glm::inverse(ubo.view)[3];
+
+		const glm::vec3 center = vertexQuantization.positionMin + vertexQuantization.positionExtent * 0.5f;
+		culling.boundingSphere = glm::vec4(glm::vec3(model * glm::vec4(center, 1.0f)), glm::length(vertexQuantization.positionExtent) * 0.5f);
+
+		// SelectLod() per instance : a LOD is drawn from where its error projects to LOD_MAX_PIXEL_ERROR pixels
+		for (uint32_t i = 0; i < instanceCullingLodCount; i++)
+		{
+			culling.lodRanges[i] = glm::uvec4(lods[i].indexCount, lods[i].firstIndex, 0, 0);
+			culling.lodDistances[i] = glm::vec4(lods[i].error * projectionScale / LOD_MAX_PIXEL_ERROR, 0.0f, 0.0f, 0.0f);
+		}
+
+		culling.instanceCount = instanceCount;
+		culling.lodCount = instanceCullingLodCount;
+
+		cullingUniformOffsets[_frame] = uniformRing.push(culling);
+	}
+}
+
+void HelloTriangleApplication::uploadGeometryChunks(const std::vector<uint32_t>& _chunks)
+{
+	const ChunkedMeshView chunks = getModelChunks();
+
+	// without split streams the whole vertex goes where the position stream would
+	const VkDeviceSize vertexSize = (useCompactVertices == true) ? sizeof(CompactVertex) : sizeof(Vertex);
+	VkDeviceSize positionSize = vertexSize;
+	if (enableSplitVertexStreams == true)
+		positionSize = (useCompactVertices == true) ? VertexStreams<CompactVertex>::POSITION_SIZE : VertexStreams<Vertex>::POSITION_SIZE;
+	const VkDeviceSize attributeSize = vertexSize - positionSize;
+
+	std::vector<CompactVertex> compactVertices;
+
+	uploadBatch.begin();
+
+	for (size_t i = 0; i < _chunks.size(); i++)
+	{
+		const MeshChunk& chunk = chunks.chunks[_chunks[i]];
+		const Vertex* chunkVertices = chunks.vertices + chunk.firstVertex;
+
+		// staging : positions | attributes | indices
+		VkBuffer stagingBuffer;
+		VkDeviceSize positionsOffset;
+		char* stagingData = static_cast<char*>(stageUpload(vertexSize * chunk.vertexCount + sizeof(uint16_t) * chunk.indexCount, stagingBuffer, positionsOffset)) - positionsOffset;
+		const VkDeviceSize attributesOffset = positionsOffset + positionSize * chunk.vertexCount;
+		const VkDeviceSize indicesOffset = attributesOffset + attributeSize * chunk.vertexCount;
+
+		const void* vertexData = chunkVertices;
+		if (useCompactVertices == true)
+		{
+			compactVertices.resize(chunk.vertexCount);
+			QuantizeVertices(chunkVertices, chunk.vertexCount, vertexQuantization, compactVertices.data());
+			vertexData = compactVertices.data();
+		}
+
+		if (enableSplitVertexStreams == false)
+			memcpy(stagingData + positionsOffset, vertexData, (size_t)(vertexSize * chunk.vertexCount));
+		else if (useCompactVertices == true)
+			VertexStreams<CompactVertex>::split(compactVertices.data(), chunk.vertexCount, stagingData + positionsOffset, stagingData + attributesOffset);
+		else
+			VertexStreams<Vertex>::split(chunkVertices, chunk.vertexCount, stagingData + positionsOffset, stagingData + attributesOffset);
+
+		memcpy(stagingData + indicesOffset, chunks.indices + chunk.firstIndex, sizeof(uint16_t) * chunk.indexCount);
+
+		const uint32_t slot = geometryPool.getSlot(_chunks[i]);
+		const VkDeviceSize slotFirstVertex = (VkDeviceSize)slot * geometrySlotVertexCount;
+
+		std::array<VkBufferCopy, 2> vertexCopies = { {
+			{ positionsOffset, positionSize * slotFirstVertex, positionSize * chunk.vertexCount },
+			{ attributesOffset, vertexAttributeStreamOffset + attributeSize * slotFirstVertex, attributeSize * chunk.vertexCount } } };
+		const uint32_t vertexCopyCount = (attributeSize > 0) ? 2 : 1;
+		const VkBufferCopy indexCopy = { indicesOffset, sizeof(uint16_t) * slot * geometrySlotIndexCount, sizeof(uint16_t) * chunk.indexCount };
+
+		VkCommandBuffer commandBuffer = uploadBatch.record();
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, vertexBuffer, vertexCopyCount, vertexCopies.data());
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, indexBuffer, 1, &indexCopy);
+
+		// only the written slot ranges change owner
+		for (uint32_t c = 0; c < vertexCopyCount; c++)
+			uploadBatch.handOverBuffer(vertexBuffer, vertexCopies[c].dstOffset, vertexCopies[c].size, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+		uploadBatch.handOverBuffer(indexBuffer, indexCopy.dstOffset, indexCopy.size, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+	}
+
+	// not waited for, the frame's draws come after the acquires on the graphics queue
+	uploadBatch.end();
 }
 
 std::vector<char> HelloTriangleApplication::readFile(const std::string& _filename)
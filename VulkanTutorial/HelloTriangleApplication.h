@@ -8,18 +8,30 @@
 #include <vulkan/vulkan.h>
 
 #include <array>
+#include <future>
 #include <optional>
 #include <string>
 #include <vector>
 #include <glm/glm.hpp>
 
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include "CompactVertex.h"
+#include "DeviceMemoryAllocator.h"
+#include "GeometryStreaming.h"
+#include "InstanceData.h"
+#include "MeshCache.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
+#include "StartupTimeline.h"
+#include "ThreadPool.h"
+#include "UniformRing.h"
+#include "UploadBatch.h"
+#include "Vertex.h"
 
 struct QueueFamilyIndices
 {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	std::optional<uint32_t> transferFamily; // transfer only, optional
 
 	bool isComplete() {
 		return graphicsFamily.has_value() && presentFamily.has_value();
@@ -40,64 +52,56 @@ struct UniformBufferObject
 	alignas(16) glm::mat4 proj;
 };
 
-struct Vertex
+// rgba8 pixels decoded on an asset loading worker
+struct DecodedTexture
 {
-	glm::vec3 pos;
-	glm::vec3 color;
-	glm::vec2 texCoord;
-
-	static VkVertexInputBindingDescription getBindingDescription()
-	{
-		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		return bindingDescription;
-	}
+	std::vector<unsigned char> pixels;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
 
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
-	{
-		// attributeDescriptions[0] - position
-		// attributeDescriptions[1] - color
-		// attributeDescriptions[2] - texCoord
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-		return attributeDescriptions;
-	}
+// accumulated by drawFrame()
+struct FrameStats
+{
+	uint32_t frameCount = 0;
+	double cpuMs = 0.0; // in drawFrame(), without the wait for the frame's fence
+	double waitMs = 0.0; // for the fence of the frame that last used the resources
+	uint32_t gpuFrameCount = 0; // frames with timestamps, only while benchmarking
+	double gpuMs = 0.0; // from the start to the end of the frame's command buffer
+	double recordMs = 0.0; // in recordCommandBuffer()
+	uint64_t drawCount = 0; // draw calls recorded
+};
 
-	bool operator==(const Vertex& other) const 
-	{
-		return pos == other.pos && color == other.color && texCoord == other.texCoord;
-	}
+// same layout as the uniform block of shaders/meshlet_cull.comp
+struct CullingUniformObject
+{
+	alignas(16) glm::vec4 frustumPlanes[6];	// model space
+	alignas(16) glm::vec4 cameraPosition;	// model space
+	uint32_t meshletCount;
 };
 
-namespace std
+// LODs the instance culling pass can choose from, array size of shaders/instance_cull.comp
+const uint32_t INSTANCE_CULLING_MAX_LOD_COUNT = 8;
+
+// same layout as the uniform block of shaders/instance_cull.comp
+struct InstanceCullingUniformObject
 {
-	template<> struct hash<Vertex>
-	{
-		size_t operator()(Vertex const& vertex) const
-		{
-			return ((hash<glm::vec3>()(vertex.pos) ^
-				(hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-				(hash<glm::vec2>()(vertex.texCoord) << 1);
-		}
-	};
-}
+	alignas(16) glm::vec4 frustumPlanes[6];	// world space
+	alignas(16) glm::vec4 cameraPosition;	// world space
+	alignas(16) glm::vec4 boundingSphere;	// the model's, before the instance transform
+	alignas(16) glm::uvec4 lodRanges[INSTANCE_CULLING_MAX_LOD_COUNT];	// x index count, y first index
+	alignas(16) glm::vec4 lodDistances[INSTANCE_CULLING_MAX_LOD_COUNT];	// x nearest distance the LOD is drawn at, for a unit scale instance
+	uint32_t instanceCount;
+	uint32_t lodCount;
+};
+
+// same layout as the Draws buffer of shaders/instance_cull.comp
+struct InstanceCullingDraws
+{
+	uint32_t drawCount; // non empty LODs, the count of vkCmdDrawIndexedIndirectCount
+	uint32_t lodInstanceCounts[INSTANCE_CULLING_MAX_LOD_COUNT];
+	VkDrawIndexedIndirectCommand draws[INSTANCE_CULLING_MAX_LOD_COUNT]; // non empty LODs first
+};
 
 class HelloTriangleApplication
 {
@@ -107,6 +111,11 @@ public:
 
 	void Run();
 
+	// draws _frameCount frames with 1 to 4 frames in flight each, once the assets are loaded,
+	// and prints the CPU frame time, GPU frame time, recording cost per draw and throughput of every setting.
+	// _drawCount : the scene is drawn that many times a frame
+	void RunFrameBenchmark(uint32_t _frameCount, uint32_t _drawCount);
+
 private:
 	void initWindow();
 
@@ -114,26 +123,44 @@ private:
 
 	void mainLoop();
 
+	// draws FRAME_BENCHMARK_WARMUP_FRAMES then _frameCount frames, frameStats holds the measured ones. returns their wall time
+	double measureFrames(uint32_t _frameCount);
+
 	VkCommandBuffer beginSingleTimeCommands();
 
 	void cleanup();
 
 	void cleanupSwapChain();
 
-	void createBuffer(VkDeviceSize _size, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _properties, VkBuffer& _buffer, VkDeviceMemory& _bufferMemory);
+	void cleanupCommandBuffers();
+
+	void cleanupSyncObjects();
+
+	void createBuffer(VkDeviceSize _size, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _properties, VkBuffer& _buffer, DeviceAllocation& _bufferMemory);
 
 	void createColorResources();
 
+	// a transient pool and a command buffer per frame in flight, recorded by recordCommandBuffer()
 	void createCommandBuffers();
 
 	void createCommandPool();
 
+	// compute pass culling meshlets into a per frame in flight index buffer and indirect draw
+	void createCullingPipeline();
+	void createCullingResources();
+
 	void createDescriptorPool(); 
 	void createDescriptorSetLayout();
 	void createDescriptorSets();
 
+	// upload through a staging buffer, read at _dstStage / _dstAccess on the graphics queue
+	void createDeviceLocalBuffer(const void* _data, VkDeviceSize _size, VkBufferUsageFlags _usage, VkPipelineStageFlags _dstStage, VkAccessFlags _dstAccess, VkBuffer& _buffer, DeviceAllocation& _bufferMemory);
+
 	void createFramebuffers();
 
+	// streaming mode : vertex / index buffers split into GeometryPool slots, filled by updateGeometryStreaming()
+	void createGeometryPool();
+
 	void createGraphicsPipeline();
 
 	void createImageViews();
@@ -142,10 +169,28 @@ private:
 
 	void createInstance();
 
+	// the instancing stress scene's transforms, a single identity instance without enableInstancing
+	void createInstanceBuffer();
+
+	// compute passes culling the instances into a per frame in flight instance buffer and indirect draws, one per LOD
+	void createInstanceCullingPipeline();
+	void createInstanceCullingResources();
+
 	void createLogicalDevice();
 
+	// suballocates the memory of every buffer and image, see createBuffer() / createImage()
+	void createMemoryAllocator();
+
+	// shown until the loaded assets are swapped in
+	void createPlaceholderModel();
+	void createPlaceholderTexture();
+
 	void createRenderPass();
 
+	// per frame in flight indirect draws, one per geometry pool slot
+	void createStreamingDrawBuffers();
+
+	// semaphores and fence per frame in flight, and the timestamp queries of the frame benchmark
 	void createSyncObjects();
 
 	VkShaderModule createShaderModule(const std::vector<char>& _code);
@@ -154,25 +199,35 @@ private:
 
 	void createSwapChain();
 
-	void createVertexBuffer();
+	// on the transfer queue when the device has a transfer-only family, staging from a STAGING_RING_SIZE ring
+	void createUploadBatch();
+
+	void createVertexBuffer(const Vertex* _vertices, size_t _vertexCount);
+
+	void createIndexBuffer(const uint32_t* _indices, size_t _indexCount, size_t _vertexCount);
+
+	// per frame in flight indirect draw of the LOD selected in updateUniformBuffer()
+	void createLodDrawBuffers();
 
-	void createIndexBuffer();
+	// builds the meshlets of the model, after createIndexBuffer()
+	void createMeshletBuffers();
 
-	void createTextureImage();
+	void createTextureImage(const DecodedTexture& _texture);
 
 	void createTextureImageView();
 
 	void createTextureSampler();
 
-	void createImage(uint32_t _width, uint32_t _height, uint32_t _mipLevels, VkSampleCountFlagBits _numSample, VkFormat _format, VkImageTiling _tiling, VkImageUsageFlags _usage, VkMemoryPropertyFlags _properties, VkImage& _image, VkDeviceMemory& _imageMemory);
+	void createImage(uint32_t _width, uint32_t _height, uint32_t _mipLevels, VkSampleCountFlagBits _numSample, VkFormat _format, VkImageTiling _tiling, VkImageUsageFlags _usage, VkMemoryPropertyFlags _properties, VkImage& _image, DeviceAllocation& _imageMemory);
 
 	void createDepthResources();
 
+	// one UNIFORM_RING_FRAME_SIZE region of the uniform ring per frame in flight
 	void createUniformBuffers();
 
-	void copyBuffer(VkBuffer _srcBuffer, VkBuffer _dstBuffer, VkDeviceSize _size);
+	void copyBuffer(VkBuffer _srcBuffer, VkDeviceSize _srcOffset, VkBuffer _dstBuffer, VkDeviceSize _size);
 
-	void copyBufferToImage(VkBuffer _buffer, VkImage _image, uint32_t _width, uint32_t _height);
+	void copyBufferToImage(VkBuffer _buffer, VkDeviceSize _bufferOffset, VkImage _image, uint32_t _width, uint32_t _height);
 
 	bool checkDeviceExtensionSupport(VkPhysicalDevice _device);
 	
@@ -180,6 +235,13 @@ private:
 	
 	bool checkValidationLayerSupport();
 
+	// _size bytes of mapped staging memory to copy from at _stagingOffset in _stagingBuffer, inside an upload batch : from its ring
+	// or, for an upload larger than the ring, from a dedicated buffer released with the batch
+	void* stageUpload(VkDeviceSize _size, VkBuffer& _stagingBuffer, VkDeviceSize& _stagingOffset);
+
+	// quantize the vertices when the model allows it, before the pipeline is created
+	void chooseVertexFormat();
+
 	// choose swap chain details
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& _capabilities);
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& _availablePresentModes);
@@ -204,6 +266,19 @@ private:
 
 	VkSampleCountFlagBits getMaxUsableSampleCount();
 
+	// secondary command buffers the scene draws are split into, 1 : recorded straight into the frame's command buffer
+	uint32_t getRecordingJobCount() const;
+
+	// vertex input of the graphics pipeline for the chosen vertex format / stream layout
+	void getVertexInputDescriptions(std::vector<VkVertexInputBindingDescription>& _bindingDescriptions, std::vector<VkVertexInputAttributeDescription>& _attributeDescriptions) const;
+
+	// model vertices, from the mesh cache on warm starts
+	const Vertex* getModelVertices() const;
+	size_t getModelVertexCount() const;
+
+	// streaming chunks of the model, from the mesh cache on warm starts
+	ChunkedMeshView getModelChunks() const;
+
 	std::vector<const char*> getRequiredExtensions();
 
 	bool hasStencilComponent(VkFormat _format);
@@ -214,19 +289,49 @@ private:
 
 	void pickPhysicalDevice();
 
+	// swaps finished assets in for the placeholders, once per frame
+	void pollAssetLoading();
+
 	void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& _createInfo);
 
 	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice _device);
 
 	int rateDeviceSuitability(VkPhysicalDevice _device);
 
+	// resets the frame's pool and records its command buffer, drawing into the _imageIndex framebuffer
+	void recordCommandBuffer(uint32_t _frame, uint32_t _imageIndex);
+
+	void recordInstanceCulling(VkCommandBuffer _commandBuffer, uint32_t _frame);
+
+	void recordMeshletCulling(VkCommandBuffer _commandBuffer, uint32_t _frame);
+
+	// binds the scene's state and records _sceneDrawCount draws of it, returns the number of draw calls
+	uint32_t recordSceneDraws(VkCommandBuffer _commandBuffer, uint32_t _frame, uint32_t _sceneDrawCount);
+
 	void recreateSwapChain();
 
+	// rebuilds the sync objects and the per frame resources for _framesInFlight frames
+	void setFramesInFlight(uint32_t _framesInFlight);
+
 	void setupDebugMessenger();
 
+	// starts reading the shaders, decoding the texture and loading the model on threadPool
+	void startAssetLoading();
+
+	// device must be idle
+	void swapInModel();
+	void swapInTexture(const DecodedTexture& _texture);
+
 	void transitionImageLayout(VkImage _image, VkFormat _format, VkImageLayout _oldLayout, VkImageLayout _newLayout, uint32_t _mipLevels);
 
-	void updateUniformBuffer(uint32_t _currentImage);
+	// pages in the chunks nearest the camera and writes the draws of the visible resident ones
+	// _modelViewProjection, _cameraPosition : for model space chunk bounds
+	void updateGeometryStreaming(uint32_t _frame, const glm::mat4& _modelViewProjection, const glm::vec3& _cameraPosition);
+
+	void updateUniformBuffer(uint32_t _frame);
+
+	// copies resident chunks into their pool slots, waits for the copy
+	void uploadGeometryChunks(const std::vector<uint32_t>& _chunks);
 
 	static std::vector<char> readFile(const std::string& _filename);
 
@@ -252,6 +357,15 @@ private:
 
 	VkQueue presentQueue;
 
+	VkQueue transferQueue = VK_NULL_HANDLE; // dedicated transfer queue, if used
+
+	DeviceMemoryAllocator memoryAllocator;
+
+	bool multiDrawIndirect = false; // device feature, enabled when supported
+
+	// VK_KHR_draw_indirect_count, loaded when the instance culling pass is on and the device has it
+	PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+
 	VkSurfaceKHR surface;
 
 	VkSwapchainKHR swapChain; 
@@ -274,43 +388,154 @@ private:
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 
 	VkCommandPool commandPool;
+	VkCommandPool transferCommandPool;
+
+	// copies and layout transitions of asset uploads, see beginSingleTimeCommands()
+	UploadBatch uploadBatch;
 
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
+	uint32_t indexCount = 0; // all LODs
+	std::vector<MeshLod> lods; // index ranges, LOD 0 is the full resolution model
+	VkIndexType indexType = VK_INDEX_TYPE_UINT32; // 16 bit when the model has few enough vertices
+
+	MeshCache meshCache; // mapped on warm start instead of filling vertices / indices
+	ChunkedMesh chunkedMesh; // streaming chunks on cold start
+
+	VertexQuantization vertexQuantization;
+	bool useCompactVertices = false; // vertex buffer holds CompactVertex instead of Vertex
+	VkDeviceSize vertexAttributeStreamOffset = 0; // start of the attribute stream when the vertex streams are split
 
 	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
+	DeviceAllocation vertexBufferMemory;
 	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
-
-	std::vector<VkBuffer> uniformBuffers;
-	std::vector<VkDeviceMemory> uniformBuffersMemory;
+	DeviceAllocation indexBufferMemory;
+
+	// InstanceData, bound at the binding after the vertex streams
+	VkBuffer instanceBuffer;
+	DeviceAllocation instanceBufferMemory;
+	uint32_t instanceCount = 1;
+	float instanceGridRadius = 0.0f; // bounding radius of the instance positions, around the origin
+
+	// every frame in flight's uniforms, bound with dynamic offsets
+	VkBuffer uniformRingBuffer;
+	DeviceAllocation uniformRingBufferMemory;
+	UniformRing uniformRing;
+
+	// per frame in flight, where updateUniformBuffer() pushed the scene / culling uniforms in the uniform ring
+	std::vector<uint32_t> sceneUniformOffsets;
+	std::vector<uint32_t> cullingUniformOffsets;
+
+	std::vector<VkBuffer> lodDrawBuffers; // VkDrawIndexedIndirectCommand
+	std::vector<DeviceAllocation> lodDrawBuffersMemory;
+
+	// geometry streaming, vertexBuffer / indexBuffer hold the pool slots
+	GeometryPool geometryPool;
+	uint32_t geometrySlotVertexCount = 0;
+	uint32_t geometrySlotIndexCount = 0;
+	VkDeviceSize geometrySlotSize = 0; // vertex and index bytes of one slot
+	uint64_t streamingFrame = 0;
+	std::vector<uint32_t> chunkOrder; // nearest first
+	std::vector<float> chunkDistances;
+	std::vector<VkBuffer> streamingDrawBuffers; // VkDrawIndexedIndirectCommand per slot
+	std::vector<DeviceAllocation> streamingDrawBuffersMemory;
+
+	uint32_t meshletCount = 0;
+	VkBuffer meshletBuffer;
+	DeviceAllocation meshletBufferMemory;
+	VkBuffer meshletVertexBuffer;
+	DeviceAllocation meshletVertexBufferMemory;
+	VkBuffer meshletTriangleBuffer;
+	DeviceAllocation meshletTriangleBufferMemory;
+
+	VkDescriptorSetLayout cullingDescriptorSetLayout;
+	VkPipelineLayout cullingPipelineLayout;
+	VkPipeline cullingPipeline;
+
+	// per frame in flight
+	VkDescriptorPool cullingDescriptorPool;
+	std::vector<VkDescriptorSet> cullingDescriptorSets;
+	std::vector<VkBuffer> culledIndexBuffers; // 32 bit indices of the visible meshlets
+	std::vector<DeviceAllocation> culledIndexBuffersMemory;
+	std::vector<VkBuffer> indirectDrawBuffers; // VkDrawIndexedIndirectCommand
+	std::vector<DeviceAllocation> indirectDrawBuffersMemory;
+
+	VkDescriptorSetLayout instanceCullingDescriptorSetLayout;
+	VkPipelineLayout instanceCullingPipelineLayout;
+	VkPipeline instanceCullingPipeline;
+	uint32_t instanceCullingLodCount = 0;
+
+	// per frame in flight
+	VkDescriptorPool instanceCullingDescriptorPool;
+	std::vector<VkDescriptorSet> instanceCullingDescriptorSets;
+	std::vector<VkBuffer> instanceLodBuffers; // LOD of every instance and its place among the LOD's visible ones
+	std::vector<DeviceAllocation> instanceLodBuffersMemory;
+	std::vector<VkBuffer> culledInstanceBuffers; // InstanceData of the visible instances, grouped by LOD
+	std::vector<DeviceAllocation> culledInstanceBuffersMemory;
+	std::vector<VkBuffer> instanceDrawBuffers; // InstanceCullingDraws
+	std::vector<DeviceAllocation> instanceDrawBuffersMemory;
 
 	uint32_t mipLevels;
 
 	VkImage textureImage;
 	VkImageView textureImageView;
 	VkSampler textureSampler;
-	VkDeviceMemory textureImageMemory;
+	DeviceAllocation textureImageMemory;
 
 	VkImage depthImage;
-	VkDeviceMemory depthImageMemory;
+	DeviceAllocation depthImageMemory;
 	VkImageView depthImageView;
 
 	VkImage colorImage;
-	VkDeviceMemory colorImageMemory;
+	DeviceAllocation colorImageMemory;
 	VkImageView colorImageView;
 
 	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
 
-	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<VkCommandPool> frameCommandPools; // per frame in flight
+	std::vector<VkCommandBuffer> commandBuffers; // per frame in flight, recorded every frame
+	uint32_t sceneDrawCount = 1; // draws of the scene a frame, more only in the frame benchmark
 
+	// parallel recording : per frame in flight * recordingSlotCount + slot, one slot per job
+	std::vector<VkCommandPool> recordingCommandPools;
+	std::vector<VkCommandBuffer> recordingCommandBuffers; // secondary
+	uint32_t recordingSlotCount = 0; // threadPool workers and the main thread
+	uint32_t recordingThreadCount = 1;
+
+	uint32_t framesInFlight = 0; // set by Run() / RunFrameBenchmark()
 	std::vector<VkSemaphore> imageAvailableSemaphores;
 	std::vector<VkSemaphore> renderFinishedSemaphores;
 	std::vector<VkFence> inFlightFences;
-	std::vector<VkFence> imagesInFlight;
-	size_t currentFrame = 0;
+	uint32_t currentFrame = 0;
+
+	FrameStats frameStats;
+	bool frameBenchmark = false;
+	VkQueryPool timestampQueryPool = VK_NULL_HANDLE; // 2 timestamps per frame in flight, only while benchmarking
+	std::vector<bool> frameTimestampsPending; // per frame in flight, submitted and not read yet
+	double timestampPeriod = 0.0; // ns per tick
+	uint64_t timestampMask = 0; // valid bits
 
 	bool framebufferResized = false;
+
+	// background asset loading
+	std::future<void> shaderLoad;
+	std::future<void> modelLoad;
+	std::future<DecodedTexture> textureLoad;
+	bool modelReady = false; // the loaded model replaced the placeholder
+
+	// SPIR-V, read once by startAssetLoading()
+	std::vector<char> vertShaderCode;
+	std::vector<char> fragShaderCode;
+	std::vector<char> cullShaderCode;
+	std::vector<char> instanceCullShaderCode;
+
+	StartupTimeline startupTimeline;
+	uint32_t shaderLoadStage = StartupTimeline::NO_STAGE;
+	uint32_t modelLoadStage = StartupTimeline::NO_STAGE;
+	uint32_t textureLoadStage = StartupTimeline::NO_STAGE;
+
+	// workers for CPU-side asset processing, declared last so it is destroyed first :
+	// a load still running at exit finishes while the members it writes are alive
+	ThreadPool threadPool;
 };
 
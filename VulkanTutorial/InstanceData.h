@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <glm/glm.hpp>
+
+// Per instance transform of the instanced draw, read from an instance rate vertex binding after the model's :
+//	world position = rotate(rotation, model position) * scale + position
+struct InstanceData
+{
+	glm::vec4 positionScale; // xyz : position, w : uniform scale
+	glm::vec4 rotation; // unit quaternion, xyz : vector part
+
+	static VkVertexInputBindingDescription getBindingDescription(uint32_t _binding)
+	{
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = _binding;
+		bindingDescription.stride = sizeof(InstanceData);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+		return bindingDescription;
+	}
+
+	// locations 3 and 4, after the vertex attributes
+	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions(uint32_t _binding)
+	{
+		std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+		attributeDescriptions[0].binding = _binding;
+		attributeDescriptions[0].location = 3;
+		attributeDescriptions[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributeDescriptions[0].offset = offsetof(InstanceData, positionScale);
+
+		attributeDescriptions[1].binding = _binding;
+		attributeDescriptions[1].location = 4;
+		attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributeDescriptions[1].offset = offsetof(InstanceData, rotation);
+
+		return attributeDescriptions;
+	}
+};
+
+static_assert(sizeof(InstanceData) == 32, "InstanceData must stay tightly packed");
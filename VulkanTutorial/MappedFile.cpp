@@ -0,0 +1,152 @@
+﻿#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& _other) noexcept
+{
+	moveFrom(_other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& _other) noexcept
+{
+	if (this != &_other)
+	{
+		close();
+		moveFrom(_other);
+	}
+
+	return *this;
+}
+
+bool MappedFile::open(const std::string& _path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (GetFileSizeEx(file, &fileSize) == FALSE)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappedSize = static_cast<size_t>(fileSize.QuadPart);
+
+	// an empty file can't be mapped, but it is still a valid (empty) file
+	if (mappedSize > 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			close();
+			return false;
+		}
+
+		mappingHandle = mapping;
+
+		mappedData = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (mappedData == nullptr)
+		{
+			close();
+			return false;
+		}
+	}
+#else
+	fileDescriptor = ::open(_path.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) != 0)
+	{
+		close();
+		return false;
+	}
+
+	mappedSize = static_cast<size_t>(fileStat.st_size);
+
+	if (mappedSize > 0)
+	{
+		void* mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		if (mapping == MAP_FAILED)
+		{
+			close();
+			return false;
+		}
+
+		mappedData = static_cast<const char*>(mapping);
+	}
+#endif
+
+	opened = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (mappedData != nullptr)
+		UnmapViewOfFile(mappedData);
+
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+
+	if (fileHandle != nullptr)
+		CloseHandle(fileHandle);
+
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+#else
+	if (mappedData != nullptr)
+		munmap(const_cast<char*>(mappedData), mappedSize);
+
+	if (fileDescriptor >= 0)
+		::close(fileDescriptor);
+
+	fileDescriptor = -1;
+#endif
+
+	mappedData = nullptr;
+	mappedSize = 0;
+	opened = false;
+}
+
+void MappedFile::moveFrom(MappedFile& _other)
+{
+#ifdef _WIN32
+	fileHandle = _other.fileHandle;
+	mappingHandle = _other.mappingHandle;
+	_other.fileHandle = nullptr;
+	_other.mappingHandle = nullptr;
+#else
+	fileDescriptor = _other.fileDescriptor;
+	_other.fileDescriptor = -1;
+#endif
+
+	mappedData = _other.mappedData;
+	mappedSize = _other.mappedSize;
+	opened = _other.opened;
+
+	_other.mappedData = nullptr;
+	_other.mappedSize = 0;
+	_other.opened = false;
+}
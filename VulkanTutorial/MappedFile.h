@@ -0,0 +1,45 @@
+﻿#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file mapped into the address space.
+// Pages are loaded on first touch, so reading the file costs no heap memory.
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& _other) noexcept;
+	MappedFile& operator=(MappedFile&& _other) noexcept;
+
+	// returns false if the file can't be opened or mapped
+	bool open(const std::string& _path);
+
+	void close();
+
+	bool isOpen() const { return opened; }
+
+	const char* data() const { return mappedData; }
+
+	size_t size() const { return mappedSize; }
+
+private:
+	void moveFrom(MappedFile& _other);
+
+private:
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+
+	const char* mappedData = nullptr;
+	size_t mappedSize = 0;
+
+	bool opened = false;
+};
@@ -0,0 +1,222 @@
+﻿#include "MeshCache.h"
+
+#include "Hash.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	const char MESH_CACHE_MAGIC[8] = { 'V', 'T', 'M', 'E', 'S', 'H', '\0', '\0' };
+
+	// bump whenever the layout or the meaning of the cached data changes
+	// 2 : vertex cache / fetch optimized meshes
+	// 3 : overdraw optimized meshes
+	// 4 : LOD chain
+	// 5 : streaming chunks
+	// 6 : processing key
+	const uint32_t MESH_CACHE_VERSION = 6;
+
+	struct MeshCacheHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t vertexStride;
+		uint64_t vertexCount;
+		uint64_t indexCount;
+		uint64_t lodCount;
+		uint64_t chunkCount;
+		uint64_t chunkVertexCount;
+		uint64_t chunkIndexCount;
+
+		// source key
+		uint64_t sourcePathHash;
+		uint64_t sourceSize;
+		int64_t sourceModifiedTime;
+		uint64_t sourceContentHash;
+
+		// settings the source was processed with
+		uint64_t processingKey;
+
+		// vertices + indices + lods + chunks, rejects truncated or corrupted caches
+		uint64_t payloadHash;
+	};
+
+	struct SourceKey
+	{
+		uint64_t pathHash = 0;
+		uint64_t size = 0;
+		int64_t modifiedTime = 0;
+		uint64_t contentHash = 0;
+	};
+
+	bool computeSourceKey(const std::string& _sourcePath, SourceKey& _key)
+	{
+		std::error_code error;
+
+		_key.size = static_cast<uint64_t>(std::filesystem::file_size(_sourcePath, error));
+		if (error)
+			return false;
+
+		_key.modifiedTime = static_cast<int64_t>(std::filesystem::last_write_time(_sourcePath, error).time_since_epoch().count());
+		if (error)
+			return false;
+
+		// hashing the mapped source is bound by I/O, not by parsing
+		MappedFile source;
+		if (source.open(_sourcePath) == false)
+			return false;
+
+		_key.contentHash = hashBytes(source.data(), source.size());
+		_key.pathHash = hashBytes(_sourcePath.data(), _sourcePath.size());
+
+		return true;
+	}
+
+	uint64_t hashPayload(const Vertex* _vertices, size_t _vertexCount, const uint32_t* _indices, size_t _indexCount, const MeshLod* _lods, size_t _lodCount,
+		const ChunkedMeshView& _chunks, size_t _chunkVertexCount, size_t _chunkIndexCount)
+	{
+		uint64_t hash = hashBytes(_vertices, _vertexCount * sizeof(Vertex));
+		hash = hashBytes(_indices, _indexCount * sizeof(uint32_t), hash);
+		hash = hashBytes(_lods, _lodCount * sizeof(MeshLod), hash);
+		hash = hashBytes(_chunks.chunks, _chunks.chunkCount * sizeof(MeshChunk), hash);
+		hash = hashBytes(_chunks.vertices, _chunkVertexCount * sizeof(Vertex), hash);
+		return hashBytes(_chunks.indices, _chunkIndexCount * sizeof(uint16_t), hash);
+	}
+}
+
+bool MeshCache::open(const std::string& _cachePath, const std::string& _sourcePath, uint64_t _processingKey)
+{
+	close();
+
+	if (file.open(_cachePath) == false)
+		return false;
+
+	MeshCacheHeader header;
+	if (file.size() < sizeof(header))
+	{
+		close();
+		return false;
+	}
+
+	memcpy(&header, file.data(), sizeof(header));
+
+	const uint64_t expectedSize = sizeof(header) + header.vertexCount * sizeof(Vertex) + header.indexCount * sizeof(uint32_t) + header.lodCount * sizeof(MeshLod) +
+		header.chunkCount * sizeof(MeshChunk) + header.chunkVertexCount * sizeof(Vertex) + header.chunkIndexCount * sizeof(uint16_t);
+
+	if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 ||
+		header.version != MESH_CACHE_VERSION ||
+		header.vertexStride != sizeof(Vertex) ||
+		header.processingKey != _processingKey ||
+		expectedSize != file.size())
+	{
+		close();
+		return false;
+	}
+
+	SourceKey key;
+	if (computeSourceKey(_sourcePath, key) == false ||
+		key.pathHash != header.sourcePathHash ||
+		key.size != header.sourceSize ||
+		key.modifiedTime != header.sourceModifiedTime ||
+		key.contentHash != header.sourceContentHash)
+	{
+		close();
+		return false;
+	}
+
+	vertices = reinterpret_cast<const Vertex*>(file.data() + sizeof(header));
+	vertexCount = static_cast<size_t>(header.vertexCount);
+
+	indices = reinterpret_cast<const uint32_t*>(file.data() + sizeof(header) + vertexCount * sizeof(Vertex));
+	indexCount = static_cast<size_t>(header.indexCount);
+
+	lods = reinterpret_cast<const MeshLod*>(file.data() + sizeof(header) + vertexCount * sizeof(Vertex) + indexCount * sizeof(uint32_t));
+	lodCount = static_cast<size_t>(header.lodCount);
+
+	chunks.chunks = reinterpret_cast<const MeshChunk*>(lods + lodCount);
+	chunks.chunkCount = static_cast<size_t>(header.chunkCount);
+	chunks.vertices = reinterpret_cast<const Vertex*>(chunks.chunks + chunks.chunkCount);
+	chunks.indices = reinterpret_cast<const uint16_t*>(chunks.vertices + header.chunkVertexCount);
+
+	if (hashPayload(vertices, vertexCount, indices, indexCount, lods, lodCount, chunks, static_cast<size_t>(header.chunkVertexCount), static_cast<size_t>(header.chunkIndexCount)) != header.payloadHash)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MeshCache::close()
+{
+	file.close();
+
+	vertices = nullptr;
+	vertexCount = 0;
+	indices = nullptr;
+	indexCount = 0;
+	lods = nullptr;
+	lodCount = 0;
+	chunks = ChunkedMeshView{};
+}
+
+bool MeshCache::write(const std::string& _cachePath, const std::string& _sourcePath, uint64_t _processingKey, const std::vector<Vertex>& _vertices, const std::vector<uint32_t>& _indices, const std::vector<MeshLod>& _lods, const ChunkedMesh& _chunks)
+{
+	SourceKey key;
+	if (computeSourceKey(_sourcePath, key) == false)
+		return false;
+
+	MeshCacheHeader header{};
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+	header.version = MESH_CACHE_VERSION;
+	header.vertexStride = sizeof(Vertex);
+	header.vertexCount = _vertices.size();
+	header.indexCount = _indices.size();
+	header.lodCount = _lods.size();
+	header.chunkCount = _chunks.chunks.size();
+	header.chunkVertexCount = _chunks.vertices.size();
+	header.chunkIndexCount = _chunks.indices.size();
+	header.sourcePathHash = key.pathHash;
+	header.sourceSize = key.size;
+	header.sourceModifiedTime = key.modifiedTime;
+	header.sourceContentHash = key.contentHash;
+	header.processingKey = _processingKey;
+
+	ChunkedMeshView chunkView;
+	chunkView.chunks = _chunks.chunks.data();
+	chunkView.chunkCount = _chunks.chunks.size();
+	chunkView.vertices = _chunks.vertices.data();
+	chunkView.indices = _chunks.indices.data();
+	header.payloadHash = hashPayload(_vertices.data(), _vertices.size(), _indices.data(), _indices.size(), _lods.data(), _lods.size(), chunkView, _chunks.vertices.size(), _chunks.indices.size());
+
+	// write next to the target and rename, so a crash never leaves a half-written cache behind
+	const std::string tempPath = _cachePath + ".tmp";
+	{
+		std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+		if (output.is_open() == false)
+			return false;
+
+		output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		output.write(reinterpret_cast<const char*>(_vertices.data()), _vertices.size() * sizeof(Vertex));
+		output.write(reinterpret_cast<const char*>(_indices.data()), _indices.size() * sizeof(uint32_t));
+		output.write(reinterpret_cast<const char*>(_lods.data()), _lods.size() * sizeof(MeshLod));
+		output.write(reinterpret_cast<const char*>(_chunks.chunks.data()), _chunks.chunks.size() * sizeof(MeshChunk));
+		output.write(reinterpret_cast<const char*>(_chunks.vertices.data()), _chunks.vertices.size() * sizeof(Vertex));
+		output.write(reinterpret_cast<const char*>(_chunks.indices.data()), _chunks.indices.size() * sizeof(uint16_t));
+
+		if (output.good() == false)
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, _cachePath, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GeometryStreaming.h"
+#include "MappedFile.h"
+#include "MeshSimplifier.h"
+#include "Vertex.h"
+
+// Versioned binary cache of the mesh produced by loadModel().
+//
+// File layout : MeshCacheHeader | Vertex[vertexCount] | uint32_t[indexCount] | MeshLod[lodCount]
+//				| MeshChunk[chunkCount] | Vertex[chunkVertexCount] | uint16_t[chunkIndexCount]
+//
+// The chunks are only written for geometry streaming, which pages them in from the mapping.
+//
+// The cache is keyed on the source path, size, modification time and content hash,
+// so editing or replacing the source model invalidates it, and on a caller provided processing key
+// so changing how the model is processed does too.
+// A valid cache is used through the mapping, which lets the vertex / index data be copied
+// straight into a staging buffer without parsing or deduplicating anything.
+class MeshCache
+{
+public:
+	// Maps _cachePath and checks it against _sourcePath and the _processingKey it was written with.
+	// Returns false (and leaves the cache closed) if the cache is missing, stale or corrupt.
+	bool open(const std::string& _cachePath, const std::string& _sourcePath, uint64_t _processingKey);
+
+	void close();
+
+	bool isOpen() const { return file.isOpen(); }
+
+	const Vertex* getVertices() const { return vertices; }
+	size_t getVertexCount() const { return vertexCount; }
+
+	const uint32_t* getIndices() const { return indices; }
+	size_t getIndexCount() const { return indexCount; }
+
+	// ranges of indices, LOD 0 first
+	const MeshLod* getLods() const { return lods; }
+	size_t getLodCount() const { return lodCount; }
+
+	// empty unless written with chunks
+	const ChunkedMeshView& getChunks() const { return chunks; }
+
+	// Writes a cache for _sourcePath processed with the settings _processingKey stands for. Returns false if the file can't be written.
+	static bool write(const std::string& _cachePath, const std::string& _sourcePath, uint64_t _processingKey, const std::vector<Vertex>& _vertices, const std::vector<uint32_t>& _indices, const std::vector<MeshLod>& _lods, const ChunkedMesh& _chunks);
+
+private:
+	MappedFile file;
+
+	const Vertex* vertices = nullptr;
+	size_t vertexCount = 0;
+
+	const uint32_t* indices = nullptr;
+	size_t indexCount = 0;
+
+	const MeshLod* lods = nullptr;
+	size_t lodCount = 0;
+
+	ChunkedMeshView chunks;
+};
@@ -0,0 +1,529 @@
+﻿#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+	// scoring from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+	const uint32_t FORSYTH_CACHE_SIZE = 32;
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	// valences above this all get the same (tiny) boost
+	const uint32_t MAX_SCORED_VALENCE = 64;
+
+	class VertexScoreTable
+	{
+	public:
+		VertexScoreTable()
+		{
+			for (uint32_t i = 0; i < FORSYTH_CACHE_SIZE; i++)
+			{
+				// the last triangle's vertices get a fixed score, so it isn't just reused immediately
+				if (i < 3)
+					cacheScores[i] = LAST_TRIANGLE_SCORE;
+				else
+					cacheScores[i] = powf(1.0f - static_cast<float>(i - 3) / static_cast<float>(FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+			}
+
+			valenceScores[0] = 0.0f;
+			for (uint32_t i = 1; i <= MAX_SCORED_VALENCE; i++)
+				valenceScores[i] = VALENCE_BOOST_SCALE * powf(static_cast<float>(i), -VALENCE_BOOST_POWER);
+		}
+
+		// _cachePosition < 0 : not in the cache
+		float score(int _cachePosition, uint32_t _remainingTriangles) const
+		{
+			// nothing left to draw with this vertex
+			if (_remainingTriangles == 0)
+				return -1.0f;
+
+			float score = valenceScores[std::min(_remainingTriangles, MAX_SCORED_VALENCE)];
+			if (_cachePosition >= 0)
+				score += cacheScores[_cachePosition];
+
+			return score;
+		}
+
+	private:
+		float cacheScores[FORSYTH_CACHE_SIZE];
+		float valenceScores[MAX_SCORED_VALENCE + 1];
+	};
+
+	// cache used to find cluster boundaries, same size AnalyzeVertexCache defaults to
+	const uint32_t OVERDRAW_CACHE_SIZE = 16;
+
+	// FIFO cache simulation over a range of triangles, used to find cluster boundaries
+	class FifoCache
+	{
+	public:
+		explicit FifoCache(size_t _vertexCount) : loadedAt(_vertexCount, 0) {}
+
+		void reset() { misses += OVERDRAW_CACHE_SIZE; } // pushes everything out
+
+		// returns the number of the triangle's vertices that missed
+		uint32_t addTriangle(const uint32_t* _corners)
+		{
+			uint32_t triangleMisses = 0;
+			for (int c = 0; c < 3; c++)
+			{
+				uint64_t& loaded = loadedAt[_corners[c]];
+				if (loaded == 0 || misses - loaded >= OVERDRAW_CACHE_SIZE)
+				{
+					misses++;
+					loaded = misses;
+					triangleMisses++;
+				}
+			}
+
+			return triangleMisses;
+		}
+
+	private:
+		std::vector<uint64_t> loadedAt;
+		uint64_t misses = OVERDRAW_CACHE_SIZE;
+	};
+
+	// triangle ranges [clusterStarts[i], clusterStarts[i + 1]) of a vertex cache optimized index buffer
+	std::vector<size_t> findClusters(const std::vector<uint32_t>& _indices, size_t _vertexCount, float _threshold)
+	{
+		const size_t triangleCount = _indices.size() / 3;
+
+		// hard boundaries : every vertex of the triangle misses, the optimizer restarted there.
+		// the first triangle always starts one, it can miss fewer than 3 times when it repeats an index
+		std::vector<size_t> hardStarts(1, 0);
+		{
+			FifoCache cache(_vertexCount);
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				if (cache.addTriangle(&_indices[t * 3]) == 3 && t > 0)
+					hardStarts.push_back(t);
+			}
+		}
+		hardStarts.push_back(triangleCount);
+
+		// soft boundaries : split a hard cluster as soon as the part so far is about as cache efficient as the whole
+		std::vector<size_t> clusterStarts;
+		FifoCache cache(_vertexCount);
+
+		for (size_t h = 0; h + 1 < hardStarts.size(); h++)
+		{
+			const size_t begin = hardStarts[h];
+			const size_t end = hardStarts[h + 1];
+
+			cache.reset();
+			size_t clusterMisses = 0;
+			for (size_t t = begin; t < end; t++)
+				clusterMisses += cache.addTriangle(&_indices[t * 3]);
+
+			const float clusterAcmr = static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+			clusterStarts.push_back(begin);
+
+			cache.reset();
+			size_t start = begin;
+			size_t misses = 0;
+
+			for (size_t t = begin; t < end; t++)
+			{
+				misses += cache.addTriangle(&_indices[t * 3]);
+
+				if (t + 1 < end && static_cast<float>(misses) / static_cast<float>(t + 1 - start) <= clusterAcmr * _threshold)
+				{
+					clusterStarts.push_back(t + 1);
+
+					cache.reset();
+					start = t + 1;
+					misses = 0;
+				}
+			}
+		}
+
+		clusterStarts.push_back(triangleCount);
+		return clusterStarts;
+	}
+
+	struct ViewBasis
+	{
+		glm::vec3 right;
+		glm::vec3 up;
+		glm::vec3 forward;
+	};
+
+	ViewBasis makeViewBasis(const glm::vec3& _forward)
+	{
+		ViewBasis basis;
+		basis.forward = glm::normalize(_forward);
+
+		glm::vec3 helper = (std::fabs(basis.forward.z) < 0.9f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		basis.right = glm::normalize(glm::cross(helper, basis.forward));
+		basis.up = glm::cross(basis.forward, basis.right);
+
+		return basis;
+	}
+
+	float edgeFunction(float _ax, float _ay, float _bx, float _by, float _px, float _py)
+	{
+		return (_bx - _ax) * (_py - _ay) - (_by - _ay) * (_px - _ax);
+	}
+}
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* _indices, size_t _indexCount, size_t _vertexCount, uint32_t _cacheSize)
+{
+	VertexCacheStats stats;
+	if (_indexCount < 3 || _vertexCount == 0)
+		return stats;
+
+	// a vertex is in the FIFO while fewer than _cacheSize misses happened since it was loaded
+	std::vector<uint64_t> loadedAt(_vertexCount, 0);
+	uint64_t misses = 0;
+
+	for (size_t i = 0; i < _indexCount; i++)
+	{
+		uint64_t& loaded = loadedAt[_indices[i]];
+
+		if (loaded == 0 || misses - loaded >= _cacheSize)
+		{
+			misses++;
+			loaded = misses;
+		}
+	}
+
+	stats.acmr = static_cast<float>(misses) / static_cast<float>(_indexCount / 3);
+	stats.atvr = static_cast<float>(misses) / static_cast<float>(_vertexCount);
+
+	return stats;
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& _indices, size_t _vertexCount)
+{
+	const size_t triangleCount = _indices.size() / 3;
+	if (triangleCount == 0 || _vertexCount == 0)
+		return;
+
+	static const VertexScoreTable scoreTable;
+
+	// vertex -> triangles that still have to be emitted, the first remainingTriangles[v] entries of its range
+	std::vector<uint32_t> remainingTriangles(_vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		remainingTriangles[_indices[i]]++;
+
+	std::vector<uint32_t> triangleOffsets(_vertexCount + 1, 0);
+	for (size_t v = 0; v < _vertexCount; v++)
+		triangleOffsets[v + 1] = triangleOffsets[v] + remainingTriangles[v];
+
+	std::vector<uint32_t> adjacentTriangles(triangleCount * 3);
+	{
+		std::vector<uint32_t> cursors(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			adjacentTriangles[cursors[_indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<float> vertexScores(_vertexCount);
+	for (size_t v = 0; v < _vertexCount; v++)
+		vertexScores[v] = scoreTable.score(-1, remainingTriangles[v]);
+
+	std::vector<float> triangleScores(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+		triangleScores[t] = vertexScores[_indices[t * 3 + 0]] + vertexScores[_indices[t * 3 + 1]] + vertexScores[_indices[t * 3 + 2]];
+
+	std::vector<char> emitted(triangleCount, 0);
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	// most recently used first, with room for the 3 vertices pushed in front before the overflow is evicted
+	uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+	uint32_t cacheCount = 0;
+
+	size_t nextUnemitted = 0;
+	size_t bestTriangle = triangleCount;
+
+	while (output.size() < triangleCount * 3)
+	{
+		if (bestTriangle == triangleCount)
+		{
+			// nothing in the cache has triangles left : restart from the first triangle not emitted yet
+			while (emitted[nextUnemitted] != 0)
+				nextUnemitted++;
+
+			bestTriangle = nextUnemitted;
+		}
+
+		emitted[bestTriangle] = 1;
+
+		const uint32_t* corners = &_indices[bestTriangle * 3];
+		uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+		uint32_t newCacheCount = 0;
+
+		for (int c = 0; c < 3; c++)
+		{
+			const uint32_t vertex = corners[c];
+			output.push_back(vertex);
+
+			// drop the triangle from the vertex's remaining list
+			uint32_t* triangles = &adjacentTriangles[triangleOffsets[vertex]];
+			uint32_t& remaining = remainingTriangles[vertex];
+			for (uint32_t i = 0; i < remaining; i++)
+			{
+				if (triangles[i] == bestTriangle)
+				{
+					triangles[i] = triangles[remaining - 1];
+					remaining--;
+					break;
+				}
+			}
+
+			if (std::find(newCache, newCache + newCacheCount, vertex) == newCache + newCacheCount)
+				newCache[newCacheCount++] = vertex;
+		}
+
+		const uint32_t frontCount = newCacheCount;
+		for (uint32_t i = 0; i < cacheCount; i++)
+		{
+			if (std::find(newCache, newCache + frontCount, cache[i]) == newCache + frontCount)
+				newCache[newCacheCount++] = cache[i];
+		}
+
+		// rescore everything that was or is in the cache : positions shifted, some vertices were evicted
+		for (uint32_t i = 0; i < newCacheCount; i++)
+		{
+			const uint32_t vertex = newCache[i];
+			const int position = (i < FORSYTH_CACHE_SIZE) ? static_cast<int>(i) : -1;
+
+			const float score = scoreTable.score(position, remainingTriangles[vertex]);
+			const float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+
+			const uint32_t* triangles = &adjacentTriangles[triangleOffsets[vertex]];
+			for (uint32_t t = 0; t < remainingTriangles[vertex]; t++)
+				triangleScores[triangles[t]] += delta;
+		}
+
+		cacheCount = std::min(newCacheCount, FORSYTH_CACHE_SIZE);
+		std::copy(newCache, newCache + cacheCount, cache);
+
+		// next triangle : the best one using a cached vertex
+		bestTriangle = triangleCount;
+		float bestScore = -1.0f;
+
+		for (uint32_t i = 0; i < cacheCount; i++)
+		{
+			const uint32_t vertex = cache[i];
+			const uint32_t* triangles = &adjacentTriangles[triangleOffsets[vertex]];
+
+			for (uint32_t t = 0; t < remainingTriangles[vertex]; t++)
+			{
+				if (triangleScores[triangles[t]] > bestScore)
+				{
+					bestScore = triangleScores[triangles[t]];
+					bestTriangle = triangles[t];
+				}
+			}
+		}
+	}
+
+	_indices.swap(output);
+}
+
+void OptimizeVertexFetch(std::vector<Vertex>& _vertices, std::vector<uint32_t>& _indices)
+{
+	const uint32_t unused = UINT32_MAX;
+
+	std::vector<uint32_t> remap(_vertices.size(), unused);
+
+	std::vector<Vertex> reordered;
+	reordered.reserve(_vertices.size());
+
+	for (uint32_t& index : _indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(_vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	_vertices.swap(reordered);
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& _indices, const std::vector<Vertex>& _vertices, float _threshold)
+{
+	const size_t triangleCount = _indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	const std::vector<size_t> clusterStarts = findClusters(_indices, _vertices.size(), _threshold);
+	const size_t clusterCount = clusterStarts.size() - 1;
+
+	// area weighted centroids and normals
+	std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+	std::vector<float> clusterAreas(clusterCount, 0.0f);
+
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+		{
+			const glm::vec3& a = _vertices[_indices[t * 3 + 0]].pos;
+			const glm::vec3& b = _vertices[_indices[t * 3 + 1]].pos;
+			const glm::vec3& p = _vertices[_indices[t * 3 + 2]].pos;
+
+			const glm::vec3 normal = glm::cross(b - a, p - a);
+			const float area = glm::length(normal);
+
+			clusterCentroids[c] += (a + b + p) * (area / 3.0f);
+			clusterNormals[c] += normal;
+			clusterAreas[c] += area;
+		}
+
+		meshCentroid += clusterCentroids[c];
+		meshArea += clusterAreas[c];
+
+		if (clusterAreas[c] > 0.0f)
+			clusterCentroids[c] /= clusterAreas[c];
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// clusters far out along their own normal occlude the rest from most directions
+	std::vector<float> sortKeys(clusterCount, 0.0f);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		const float normalLength = glm::length(clusterNormals[c]);
+		if (normalLength > 0.0f)
+			sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c] / normalLength);
+	}
+
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+		order[c] = c;
+
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t _a, size_t _b) { return sortKeys[_a] > sortKeys[_b]; });
+
+	std::vector<uint32_t> reordered;
+	reordered.reserve(_indices.size());
+
+	for (size_t c : order)
+		reordered.insert(reordered.end(), _indices.begin() + clusterStarts[c] * 3, _indices.begin() + clusterStarts[c + 1] * 3);
+
+	// the clusters cover every triangle, a reordering never drops one
+	if (reordered.size() != triangleCount * 3)
+		throw std::runtime_error("overdraw optimization lost triangles!");
+
+	_indices.swap(reordered);
+}
+
+OverdrawStats AnalyzeOverdraw(const uint32_t* _indices, size_t _indexCount, const Vertex* _vertices, size_t _vertexCount, uint32_t _resolution)
+{
+	OverdrawStats stats;
+	if (_indexCount < 3 || _vertexCount == 0 || _resolution == 0)
+		return stats;
+
+	std::vector<glm::vec3> directions;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (float sign : { -1.0f, 1.0f })
+		{
+			glm::vec3 direction(0.0f);
+			direction[axis] = sign;
+			directions.push_back(direction);
+		}
+	}
+	for (int corner = 0; corner < 8; corner++)
+		directions.push_back(glm::vec3((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f));
+
+	std::vector<glm::vec3> projected(_vertexCount);
+	std::vector<float> depthBuffer(static_cast<size_t>(_resolution) * _resolution);
+
+	for (const glm::vec3& direction : directions)
+	{
+		const ViewBasis view = makeViewBasis(direction);
+
+		// orthographic camera on the direction side, looking back at the mesh
+		glm::vec3 minimum(FLT_MAX);
+		glm::vec3 maximum(-FLT_MAX);
+		for (size_t v = 0; v < _vertexCount; v++)
+		{
+			const glm::vec3& pos = _vertices[v].pos;
+			projected[v] = glm::vec3(glm::dot(pos, view.right), glm::dot(pos, view.up), -glm::dot(pos, view.forward));
+
+			minimum = glm::min(minimum, projected[v]);
+			maximum = glm::max(maximum, projected[v]);
+		}
+
+		const float extent = std::max(std::max(maximum.x - minimum.x, maximum.y - minimum.y), 1e-6f);
+		const float scale = static_cast<float>(_resolution) / extent;
+
+		for (glm::vec3& point : projected)
+		{
+			point.x = (point.x - minimum.x) * scale;
+			point.y = (point.y - minimum.y) * scale;
+		}
+
+		std::fill(depthBuffer.begin(), depthBuffer.end(), FLT_MAX);
+
+		for (size_t i = 0; i + 2 < _indexCount; i += 3)
+		{
+			const glm::vec3& a = projected[_indices[i + 0]];
+			const glm::vec3& b = projected[_indices[i + 1]];
+			const glm::vec3& c = projected[_indices[i + 2]];
+
+			// back face culling, counter clockwise front faces
+			const float area = edgeFunction(a.x, a.y, b.x, b.y, c.x, c.y);
+			if (area <= 0.0f)
+				continue;
+
+			const int minX = std::max(0, static_cast<int>(std::floor(std::min({ a.x, b.x, c.x }))));
+			const int maxX = std::min(static_cast<int>(_resolution) - 1, static_cast<int>(std::ceil(std::max({ a.x, b.x, c.x }))));
+			const int minY = std::max(0, static_cast<int>(std::floor(std::min({ a.y, b.y, c.y }))));
+			const int maxY = std::min(static_cast<int>(_resolution) - 1, static_cast<int>(std::ceil(std::max({ a.y, b.y, c.y }))));
+
+			for (int y = minY; y <= maxY; y++)
+			{
+				for (int x = minX; x <= maxX; x++)
+				{
+					const float px = x + 0.5f;
+					const float py = y + 0.5f;
+
+					const float w0 = edgeFunction(b.x, b.y, c.x, c.y, px, py);
+					const float w1 = edgeFunction(c.x, c.y, a.x, a.y, px, py);
+					const float w2 = edgeFunction(a.x, a.y, b.x, b.y, px, py);
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+						continue;
+
+					const float depth = (w0 * a.z + w1 * b.z + w2 * c.z) / area;
+
+					float& stored = depthBuffer[static_cast<size_t>(y) * _resolution + x];
+					if (depth < stored)
+					{
+						stored = depth;
+						stats.pixelsShaded++;
+					}
+				}
+			}
+		}
+
+		for (float depth : depthBuffer)
+		{
+			if (depth != FLT_MAX)
+				stats.pixelsCovered++;
+		}
+	}
+
+	if (stats.pixelsCovered > 0)
+		stats.overdraw = static_cast<float>(stats.pixelsShaded) / static_cast<float>(stats.pixelsCovered);
+
+	return stats;
+}
@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// Offline index / vertex buffer reordering for the GPU, run on the CPU after loadModel() deduplicated the mesh.
+
+struct VertexCacheStats
+{
+	float acmr = 0.0f; // average cache miss ratio : transformed vertices per triangle (0.5 best, 3 worst)
+	float atvr = 0.0f; // average transformed vertex ratio : transformed vertices per vertex (1 best)
+};
+
+struct OverdrawStats
+{
+	uint64_t pixelsCovered = 0;
+	uint64_t pixelsShaded = 0;
+	float overdraw = 0.0f; // shaded / covered pixels (1 best)
+};
+
+// Simulates a FIFO post-transform cache of _cacheSize entries over a triangle list.
+VertexCacheStats AnalyzeVertexCache(const uint32_t* _indices, size_t _indexCount, size_t _vertexCount, uint32_t _cacheSize = 16);
+
+// Reorders the triangles of _indices for the post-transform vertex cache (Tom Forsyth's linear-speed algorithm).
+void OptimizeVertexCache(std::vector<uint32_t>& _indices, size_t _vertexCount);
+
+// Reorders the triangle clusters of a vertex cache optimized _indices so that clusters facing away from the mesh center,
+// which tend to occlude the rest from most view directions, are drawn first.
+// Clusters are split only where the vertex cache would restart anyway, or where splitting keeps the cluster's ACMR
+// within _threshold of the unsplit one, so vertex cache efficiency is mostly preserved.
+// Run between OptimizeVertexCache and OptimizeVertexFetch.
+void OptimizeOverdraw(std::vector<uint32_t>& _indices, const std::vector<Vertex>& _vertices, float _threshold = 1.05f);
+
+// Offline overdraw estimate : rasterizes the back face culled mesh with a depth test into a _resolution x _resolution
+// grid from 14 view directions around it (axes and cube diagonals), counting pixels that pass the depth test.
+OverdrawStats AnalyzeOverdraw(const uint32_t* _indices, size_t _indexCount, const Vertex* _vertices, size_t _vertexCount, uint32_t _resolution = 256);
+
+// Reorders _vertices in the order _indices first reference them, so vertex fetch walks memory mostly linearly,
+// and remaps _indices to match. Vertices no triangle uses are dropped.
+void OptimizeVertexFetch(std::vector<Vertex>& _vertices, std::vector<uint32_t>& _indices);
@@ -0,0 +1,461 @@
+﻿#include "MeshSimplifier.h"
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// border planes weigh this much more than surface planes, which keeps the silhouette of open meshes
+	const double BORDER_WEIGHT = 10.0;
+
+	// collapses in one pass cost at most this much more than the pass's goal-th cheapest one
+	const double PASS_ERROR_BOUND = 1.5;
+
+	// a level that removes less than this fraction of the previous one's triangles ends the chain
+	const float MIN_LOD_REDUCTION = 0.1f;
+
+	// symmetric 3x3 A, b and c of the distance form p'Ap + 2b'p + c, summed over planes weighted by w
+	struct Quadric
+	{
+		double a00 = 0.0, a11 = 0.0, a22 = 0.0, a10 = 0.0, a20 = 0.0, a21 = 0.0;
+		double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+		double c = 0.0;
+		double w = 0.0;
+
+		void addPlane(const glm::vec3& _normal, double _distance, double _weight)
+		{
+			const double x = _normal.x, y = _normal.y, z = _normal.z;
+
+			a00 += _weight * x * x;
+			a11 += _weight * y * y;
+			a22 += _weight * z * z;
+			a10 += _weight * y * x;
+			a20 += _weight * z * x;
+			a21 += _weight * z * y;
+			b0 += _weight * x * _distance;
+			b1 += _weight * y * _distance;
+			b2 += _weight * z * _distance;
+			c += _weight * _distance * _distance;
+			w += _weight;
+		}
+
+		void add(const Quadric& _other)
+		{
+			a00 += _other.a00; a11 += _other.a11; a22 += _other.a22;
+			a10 += _other.a10; a20 += _other.a20; a21 += _other.a21;
+			b0 += _other.b0; b1 += _other.b1; b2 += _other.b2;
+			c += _other.c;
+			w += _other.w;
+		}
+
+		// weighted mean squared distance of _p from the planes
+		double error(const glm::vec3& _p) const
+		{
+			const double x = _p.x, y = _p.y, z = _p.z;
+
+			double r = a00 * x * x + a11 * y * y + a22 * z * z;
+			r += 2.0 * (a10 * x * y + a20 * x * z + a21 * y * z);
+			r += 2.0 * (b0 * x + b1 * y + b2 * z);
+			r += c;
+
+			return (w > 0.0) ? std::fabs(r) / w : 0.0;
+		}
+	};
+
+	enum class VertexKind : uint8_t
+	{
+		Manifold,	// collapses onto any neighbour
+		Border,		// collapses along the mesh border only
+		Locked,		// on a uv seam, never collapses
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double error;
+	};
+
+	// first vertex with the same position, so topology ignores uv seams
+	std::vector<uint32_t> buildPositionRemap(const Vertex* _vertices, size_t _vertexCount)
+	{
+		std::vector<uint32_t> order(_vertexCount);
+		for (uint32_t i = 0; i < _vertexCount; i++)
+			order[i] = i;
+
+		auto positionLess = [&](uint32_t _a, uint32_t _b)
+		{
+			return memcmp(&_vertices[_a].pos, &_vertices[_b].pos, sizeof(glm::vec3)) < 0;
+		};
+		std::sort(order.begin(), order.end(), [&](uint32_t _a, uint32_t _b)
+		{
+			return positionLess(_a, _b) || (positionLess(_b, _a) == false && _a < _b);
+		});
+
+		std::vector<uint32_t> remap(_vertexCount);
+		for (size_t i = 0; i < _vertexCount; i++)
+		{
+			const bool samePosition = i > 0 && memcmp(&_vertices[order[i]].pos, &_vertices[order[i - 1]].pos, sizeof(glm::vec3)) == 0;
+			remap[order[i]] = (samePosition == true) ? remap[order[i - 1]] : order[i];
+		}
+
+		return remap;
+	}
+
+	// position space half edges, CSR by start vertex
+	struct EdgeAdjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> targets;
+
+		bool hasEdge(uint32_t _from, uint32_t _to) const
+		{
+			for (uint32_t i = offsets[_from]; i < offsets[_from + 1]; i++)
+			{
+				if (targets[i] == _to)
+					return true;
+			}
+
+			return false;
+		}
+	};
+
+	EdgeAdjacency buildEdgeAdjacency(const std::vector<uint32_t>& _indices, const std::vector<uint32_t>& _positionRemap)
+	{
+		EdgeAdjacency adjacency;
+		adjacency.offsets.assign(_positionRemap.size() + 1, 0);
+		adjacency.targets.resize(_indices.size());
+
+		for (uint32_t index : _indices)
+			adjacency.offsets[_positionRemap[index] + 1]++;
+
+		for (size_t i = 1; i < adjacency.offsets.size(); i++)
+			adjacency.offsets[i] += adjacency.offsets[i - 1];
+
+		std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		for (size_t i = 0; i < _indices.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				const uint32_t from = _positionRemap[_indices[i + e]];
+				const uint32_t to = _positionRemap[_indices[i + (e + 1) % 3]];
+				adjacency.targets[fill[from]++] = to;
+			}
+		}
+
+		return adjacency;
+	}
+
+	glm::vec3 triangleNormal(const glm::vec3& _a, const glm::vec3& _b, const glm::vec3& _c)
+	{
+		return glm::cross(_b - _a, _c - _a);
+	}
+
+	// moving _from onto _to must not turn any remaining triangle around _from over
+	bool flipsTriangles(uint32_t _from, uint32_t _to, const std::vector<uint32_t>& _indices, const std::vector<uint32_t>& _triangleOffsets, const std::vector<uint32_t>& _triangles, const Vertex* _vertices)
+	{
+		for (uint32_t i = _triangleOffsets[_from]; i < _triangleOffsets[_from + 1]; i++)
+		{
+			const uint32_t* triangle = &_indices[_triangles[i] * 3];
+
+			if (triangle[0] == _to || triangle[1] == _to || triangle[2] == _to)
+				continue; // collapses away
+
+			glm::vec3 corners[3];
+			for (int c = 0; c < 3; c++)
+				corners[c] = _vertices[triangle[c]].pos;
+
+			const glm::vec3 before = triangleNormal(corners[0], corners[1], corners[2]);
+			for (int c = 0; c < 3; c++)
+			{
+				if (triangle[c] == _from)
+					corners[c] = _vertices[_to].pos;
+			}
+			const glm::vec3 after = triangleNormal(corners[0], corners[1], corners[2]);
+
+			if (glm::dot(before, after) <= 0.0f)
+				return true;
+		}
+
+		return false;
+	}
+}
+
+std::vector<uint32_t> SimplifyMesh(const uint32_t* _indices, size_t _indexCount, const Vertex* _vertices, size_t _vertexCount, size_t _targetIndexCount, float _targetError, float& _resultError)
+{
+	std::vector<uint32_t> result(_indices, _indices + _indexCount);
+	_resultError = 0.0f;
+
+	const std::vector<uint32_t> positionRemap = buildPositionRemap(_vertices, _vertexCount);
+	const EdgeAdjacency edges = buildEdgeAdjacency(result, positionRemap);
+
+	// a half edge without its opposite lies on the border
+	auto isBorderEdge = [&](uint32_t _a, uint32_t _b)
+	{
+		const uint32_t a = positionRemap[_a];
+		const uint32_t b = positionRemap[_b];
+		return (edges.hasEdge(a, b) == true && edges.hasEdge(b, a) == false) || (edges.hasEdge(b, a) == true && edges.hasEdge(a, b) == false);
+	};
+
+	// seams : vertices sharing their position with another vertex
+	std::vector<uint32_t> wedgeCounts(_vertexCount, 0);
+	for (size_t v = 0; v < _vertexCount; v++)
+		wedgeCounts[positionRemap[v]]++;
+
+	std::vector<VertexKind> kinds(_vertexCount, VertexKind::Manifold);
+	for (size_t v = 0; v < _vertexCount; v++)
+	{
+		if (wedgeCounts[positionRemap[v]] > 1)
+			kinds[v] = VertexKind::Locked;
+	}
+
+	// quadrics live on positions, so seam vertices share theirs
+	std::vector<Quadric> quadrics(_vertexCount);
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		const glm::vec3& a = _vertices[result[i + 0]].pos;
+		const glm::vec3& b = _vertices[result[i + 1]].pos;
+		const glm::vec3& c = _vertices[result[i + 2]].pos;
+
+		glm::vec3 normal = triangleNormal(a, b, c);
+		const float doubleArea = glm::length(normal);
+		if (doubleArea <= 0.0f)
+			continue;
+
+		normal /= doubleArea;
+
+		Quadric plane;
+		plane.addPlane(normal, -glm::dot(normal, a), doubleArea * 0.5);
+
+		for (int corner = 0; corner < 3; corner++)
+			quadrics[positionRemap[result[i + corner]]].add(plane);
+
+		// border edges get a plane perpendicular to the triangle through them
+		for (int e = 0; e < 3; e++)
+		{
+			const uint32_t from = result[i + e];
+			const uint32_t to = result[i + (e + 1) % 3];
+
+			if (isBorderEdge(from, to) == false)
+				continue;
+
+			const glm::vec3 edge = _vertices[to].pos - _vertices[from].pos;
+			const float edgeLength = glm::length(edge);
+			if (edgeLength <= 0.0f)
+				continue;
+
+			const glm::vec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+
+			Quadric border;
+			border.addPlane(borderNormal, -glm::dot(borderNormal, _vertices[from].pos), edgeLength * edgeLength * BORDER_WEIGHT);
+
+			quadrics[positionRemap[from]].add(border);
+			quadrics[positionRemap[to]].add(border);
+
+			if (kinds[from] == VertexKind::Manifold)
+				kinds[from] = VertexKind::Border;
+			if (kinds[to] == VertexKind::Manifold)
+				kinds[to] = VertexKind::Border;
+		}
+	}
+
+	const double maxError = static_cast<double>(_targetError) * _targetError;
+	double resultError = 0.0;
+
+	std::vector<uint32_t> remap(_vertexCount);
+	std::vector<uint8_t> touched(_vertexCount);
+	std::vector<uint32_t> triangleOffsets(_vertexCount + 1);
+	std::vector<uint32_t> triangles;
+	std::vector<Collapse> collapses;
+
+	// passes of independent collapses, cheapest first, until the target or the error limit is hit
+	while (result.size() > _targetIndexCount)
+	{
+		// vertex -> triangles, CSR
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (uint32_t index : result)
+			triangleOffsets[index + 1]++;
+		for (size_t v = 1; v <= _vertexCount; v++)
+			triangleOffsets[v] += triangleOffsets[v - 1];
+
+		triangles.resize(result.size());
+		{
+			std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (size_t i = 0; i < result.size(); i++)
+				triangles[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				const uint32_t a = result[i + e];
+				const uint32_t b = result[i + (e + 1) % 3];
+
+				// interior edges show up in both their triangles, take them once
+				if (a > b && isBorderEdge(a, b) == false)
+					continue;
+
+				// cheaper allowed direction of the edge
+				Collapse best{ 0, 0, -1.0 };
+				const uint32_t ends[2][2] = { { a, b }, { b, a } };
+
+				for (const auto& end : ends)
+				{
+					const uint32_t from = end[0];
+					const uint32_t to = end[1];
+
+					if (kinds[from] == VertexKind::Locked)
+						continue;
+					if (kinds[from] == VertexKind::Border && (kinds[to] == VertexKind::Manifold || isBorderEdge(from, to) == false))
+						continue;
+
+					Quadric merged = quadrics[positionRemap[from]];
+					merged.add(quadrics[positionRemap[to]]);
+
+					const double error = merged.error(_vertices[to].pos);
+					if (best.error < 0.0 || error < best.error)
+						best = Collapse{ from, to, error };
+				}
+
+				if (best.error >= 0.0 && best.error <= maxError)
+					collapses.push_back(best);
+			}
+		}
+
+		if (collapses.empty() == true)
+			break;
+
+		for (uint32_t v = 0; v < _vertexCount; v++)
+			remap[v] = v;
+		std::fill(touched.begin(), touched.end(), 0);
+
+		// a manifold collapse removes two triangles, a border collapse one
+		const size_t trianglesToRemove = (result.size() - _targetIndexCount) / 3;
+		size_t trianglesRemoved = 0;
+		size_t collapseCount = 0;
+
+		auto errorLess = [](const Collapse& _a, const Collapse& _b) { return _a.error < _b.error; };
+
+		// collapses that lose out to a touched neighbour don't drag in much costlier ones this pass,
+		// and only the candidates under that bound need sorting
+		const size_t collapseGoal = std::min(std::max<size_t>(trianglesToRemove / 2, 1), collapses.size()) - 1;
+		std::nth_element(collapses.begin(), collapses.begin() + collapseGoal, collapses.end(), errorLess);
+
+		const double passMaxError = collapses[collapseGoal].error * PASS_ERROR_BOUND;
+		auto passEnd = std::partition(collapses.begin() + collapseGoal, collapses.end(), [&](const Collapse& _collapse) { return _collapse.error <= passMaxError; });
+		collapses.erase(passEnd, collapses.end());
+
+		std::sort(collapses.begin(), collapses.end(), errorLess);
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (trianglesRemoved >= trianglesToRemove)
+				break;
+
+			// both ends keep their quadrics and neighbourhoods valid for the rest of the pass
+			if (touched[collapse.from] != 0 || touched[collapse.to] != 0)
+				continue;
+
+			if (flipsTriangles(collapse.from, collapse.to, result, triangleOffsets, triangles, _vertices) == true)
+				continue;
+
+			// neighbours of from change shape, so their collapses are reevaluated next pass
+			for (uint32_t i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1]; i++)
+			{
+				const uint32_t* triangle = &result[triangles[i] * 3];
+				for (int c = 0; c < 3; c++)
+					touched[triangle[c]] = 1;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[positionRemap[collapse.to]].add(quadrics[positionRemap[collapse.from]]);
+
+			resultError = std::max(resultError, collapse.error);
+			trianglesRemoved += (kinds[collapse.from] == VertexKind::Border) ? 1 : 2;
+			collapseCount++;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// apply, dropping the triangles that collapsed
+		size_t writeIndex = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			const uint32_t a = remap[result[i + 0]];
+			const uint32_t b = remap[result[i + 1]];
+			const uint32_t c = remap[result[i + 2]];
+
+			if (a == b || b == c || c == a)
+				continue;
+
+			result[writeIndex++] = a;
+			result[writeIndex++] = b;
+			result[writeIndex++] = c;
+		}
+		result.resize(writeIndex);
+	}
+
+	_resultError = static_cast<float>(std::sqrt(resultError));
+
+	return result;
+}
+
+std::vector<MeshLod> BuildLodChain(std::vector<uint32_t>& _indices, const std::vector<Vertex>& _vertices, uint32_t _maxLodCount)
+{
+	std::vector<MeshLod> lods;
+	lods.push_back(MeshLod{ 0, static_cast<uint32_t>(_indices.size()), 0.0f });
+
+	// error bound relative to the model size, coarser levels are still worth having for far away models
+	glm::vec3 minimum = _vertices.empty() == false ? _vertices[0].pos : glm::vec3(0.0f);
+	glm::vec3 maximum = minimum;
+	for (const Vertex& vertex : _vertices)
+	{
+		minimum = glm::min(minimum, vertex.pos);
+		maximum = glm::max(maximum, vertex.pos);
+	}
+	const float maxError = glm::length(maximum - minimum) * 0.1f;
+
+	while (lods.size() < _maxLodCount)
+	{
+		const MeshLod& previous = lods.back();
+		const size_t targetIndexCount = (previous.indexCount / 3 / 2) * 3;
+
+		// from the previous level, each level then costs about half of the one before
+		float error = 0.0f;
+		std::vector<uint32_t> lodIndices = SimplifyMesh(_indices.data() + previous.firstIndex, previous.indexCount, _vertices.data(), _vertices.size(), targetIndexCount, maxError - previous.error, error);
+
+		if (lodIndices.empty() == true || lodIndices.size() > previous.indexCount * (1.0f - MIN_LOD_REDUCTION))
+			break;
+
+		OptimizeVertexCache(lodIndices, _vertices.size());
+
+		lods.push_back(MeshLod{ static_cast<uint32_t>(_indices.size()), static_cast<uint32_t>(lodIndices.size()), previous.error + error }); // bound on the distance from LOD 0
+		_indices.insert(_indices.end(), lodIndices.begin(), lodIndices.end());
+	}
+
+	return lods;
+}
+
+uint32_t SelectLod(const std::vector<MeshLod>& _lods, float _distance, float _projectionScale, float _maxPixelError)
+{
+	// inside the model or right at it, nothing but full resolution
+	if (_distance <= 0.0f)
+		return 0;
+
+	uint32_t lod = 0;
+	for (uint32_t i = 1; i < _lods.size(); i++)
+	{
+		if (_lods[i].error * _projectionScale / _distance > _maxPixelError)
+			break;
+
+		lod = i;
+	}
+
+	return lod;
+}
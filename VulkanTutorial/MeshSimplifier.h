@@ -0,0 +1,30 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// One level of detail : a range of the shared index buffer.
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error; // model space distance from the full resolution surface
+};
+
+// Simplifies a triangle list towards _targetIndexCount by quadric error metric edge collapses
+// (Garland & Heckbert), stopping early rather than exceeding _targetError (model space distance).
+// Vertices are only ever collapsed onto existing vertices, so the result indexes the same vertex buffer.
+// Mesh border vertices only slide along the border and uv seam vertices stay put, so no cracks open.
+// _resultError : error of the result, same units as _targetError
+std::vector<uint32_t> SimplifyMesh(const uint32_t* _indices, size_t _indexCount, const Vertex* _vertices, size_t _vertexCount, size_t _targetIndexCount, float _targetError, float& _resultError);
+
+// Appends up to _maxLodCount - 1 coarser levels, each about half the triangles of the previous one,
+// after the full resolution triangles of _indices, and returns the ranges (LOD 0 first).
+// Stops when simplification stalls. Each level is vertex cache optimized.
+std::vector<MeshLod> BuildLodChain(std::vector<uint32_t>& _indices, const std::vector<Vertex>& _vertices, uint32_t _maxLodCount);
+
+// Coarsest level whose error projects to at most _maxPixelError pixels at _distance from the camera.
+// _projectionScale : proj[1][1] * viewport height / 2, the pixels covered by a model space unit at distance 1
+uint32_t SelectLod(const std::vector<MeshLod>& _lods, float _distance, float _projectionScale, float _maxPixelError);
@@ -0,0 +1,174 @@
+﻿#include "Meshlet.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	// triangles whose normals spread further than this can face away from any camera, so the cone can't cull them
+	const float MIN_CONE_DOT = 0.1f;
+
+	void computeBounds(Meshlet& _meshlet, const MeshletMesh& _mesh, const Vertex* _vertices)
+	{
+		// bounding sphere around the bounding box center
+		glm::vec3 minimum(FLT_MAX);
+		glm::vec3 maximum(-FLT_MAX);
+		for (uint32_t i = 0; i < _meshlet.vertexCount; i++)
+		{
+			const glm::vec3& pos = _vertices[_mesh.vertices[_meshlet.vertexOffset + i]].pos;
+			minimum = glm::min(minimum, pos);
+			maximum = glm::max(maximum, pos);
+		}
+
+		const glm::vec3 center = (minimum + maximum) * 0.5f;
+		float radius = 0.0f;
+		for (uint32_t i = 0; i < _meshlet.vertexCount; i++)
+			radius = std::max(radius, glm::distance(center, _vertices[_mesh.vertices[_meshlet.vertexOffset + i]].pos));
+
+		_meshlet.boundingSphere = glm::vec4(center, radius);
+
+		// normal cone
+		std::vector<glm::vec3> normals;
+		normals.reserve(_meshlet.triangleCount);
+
+		glm::vec3 axis(0.0f);
+		for (uint32_t t = 0; t < _meshlet.triangleCount; t++)
+		{
+			const uint32_t packed = _mesh.triangles[_meshlet.triangleOffset + t];
+			const glm::vec3& a = _vertices[_mesh.vertices[_meshlet.vertexOffset + (packed & 0xff)]].pos;
+			const glm::vec3& b = _vertices[_mesh.vertices[_meshlet.vertexOffset + ((packed >> 8) & 0xff)]].pos;
+			const glm::vec3& c = _vertices[_mesh.vertices[_meshlet.vertexOffset + ((packed >> 16) & 0xff)]].pos;
+
+			const glm::vec3 normal = glm::cross(b - a, c - a);
+			const float length = glm::length(normal);
+			if (length <= 0.0f)
+				continue; // degenerate
+
+			normals.push_back(normal / length);
+			axis += normals.back();
+		}
+
+		_meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		const float axisLength = glm::length(axis);
+		if (axisLength <= 0.0f)
+			return;
+
+		axis /= axisLength;
+
+		float minDot = 1.0f;
+		for (const glm::vec3& normal : normals)
+			minDot = std::min(minDot, glm::dot(normal, axis));
+
+		if (minDot <= MIN_CONE_DOT)
+			return;
+
+		// sin of the cone's half angle, see IsMeshletVisible
+		_meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+	}
+}
+
+MeshletMesh BuildMeshlets(const uint32_t* _indices, size_t _indexCount, const Vertex* _vertices, size_t _vertexCount)
+{
+	MeshletMesh mesh;
+
+	// meshlet local index of each vertex, valid while localIndexOwner says the current meshlet owns it
+	std::vector<uint8_t> localIndices(_vertexCount, 0);
+	std::vector<uint32_t> localIndexOwner(_vertexCount, UINT32_MAX);
+
+	Meshlet current{};
+
+	auto finishMeshlet = [&]()
+	{
+		if (current.triangleCount == 0)
+			return;
+
+		computeBounds(current, mesh, _vertices);
+		mesh.meshlets.push_back(current);
+
+		current = Meshlet{};
+		current.vertexOffset = static_cast<uint32_t>(mesh.vertices.size());
+		current.triangleOffset = static_cast<uint32_t>(mesh.triangles.size());
+	};
+
+	for (size_t i = 0; i + 2 < _indexCount; i += 3)
+	{
+		const uint32_t meshletIndex = static_cast<uint32_t>(mesh.meshlets.size());
+
+		uint32_t newVertices = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			if (localIndexOwner[_indices[i + c]] != meshletIndex)
+				newVertices++;
+		}
+
+		// repeated corners of a degenerate triangle are counted twice, which only ends the meshlet a little early
+		if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.triangleCount + 1 > MESHLET_MAX_TRIANGLES)
+			finishMeshlet();
+
+		const uint32_t owner = static_cast<uint32_t>(mesh.meshlets.size());
+		uint32_t packed = 0;
+
+		for (int c = 0; c < 3; c++)
+		{
+			const uint32_t vertex = _indices[i + c];
+
+			if (localIndexOwner[vertex] != owner)
+			{
+				localIndexOwner[vertex] = owner;
+				localIndices[vertex] = static_cast<uint8_t>(current.vertexCount++);
+				mesh.vertices.push_back(vertex);
+			}
+
+			packed |= static_cast<uint32_t>(localIndices[vertex]) << (8 * c);
+		}
+
+		mesh.triangles.push_back(packed);
+		current.triangleCount++;
+	}
+
+	finishMeshlet();
+
+	return mesh;
+}
+
+void ExtractFrustumPlanes(const glm::mat4& _viewProjection, glm::vec4 _planes[6])
+{
+	// rows of the (column major) matrix
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++)
+		rows[r] = glm::vec4(_viewProjection[0][r], _viewProjection[1][r], _viewProjection[2][r], _viewProjection[3][r]);
+
+	_planes[0] = rows[3] + rows[0]; // left
+	_planes[1] = rows[3] - rows[0]; // right
+	_planes[2] = rows[3] + rows[1]; // bottom
+	_planes[3] = rows[3] - rows[1]; // top
+	_planes[4] = rows[2];			// near, depth range [0, 1]
+	_planes[5] = rows[3] - rows[2]; // far
+
+	for (int p = 0; p < 6; p++)
+	{
+		const float length = glm::length(glm::vec3(_planes[p].x, _planes[p].y, _planes[p].z));
+		if (length > 0.0f)
+			_planes[p] = _planes[p] / length;
+	}
+}
+
+bool IsMeshletVisible(const Meshlet& _meshlet, const glm::vec4 _planes[6], const glm::vec3& _cameraPosition)
+{
+	const glm::vec3 center(_meshlet.boundingSphere.x, _meshlet.boundingSphere.y, _meshlet.boundingSphere.z);
+	const float radius = _meshlet.boundingSphere.w;
+
+	for (int p = 0; p < 6; p++)
+	{
+		if (glm::dot(glm::vec3(_planes[p].x, _planes[p].y, _planes[p].z), center) + _planes[p].w < -radius)
+			return false;
+	}
+
+	// every triangle faces away from the camera, wherever in the sphere it is
+	const glm::vec3 toCenter = center - _cameraPosition;
+	const glm::vec3 axis(_meshlet.cone.x, _meshlet.cone.y, _meshlet.cone.z);
+
+	return glm::dot(toCenter, axis) < _meshlet.cone.w * glm::length(toCenter) + radius;
+}
@@ -0,0 +1,40 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// limits of one meshlet, 124 triangles leaves room for a 4 byte header in 128 x 3 byte primitive blocks
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Same layout as the Meshlet struct in shaders/meshlet_cull.comp (std430).
+struct Meshlet
+{
+	glm::vec4 boundingSphere;	// xyz center, w radius
+	glm::vec4 cone;				// xyz axis, w cutoff (1 : never backface culled)
+	uint32_t vertexOffset;		// first entry in MeshletMesh::vertices
+	uint32_t triangleOffset;	// first entry in MeshletMesh::triangles
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+};
+
+static_assert(sizeof(Meshlet) == 48, "Meshlet must match the std430 layout of the shader");
+
+struct MeshletMesh
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> vertices;		// meshlet local vertex -> index into the vertex buffer
+	std::vector<uint32_t> triangles;	// one per triangle, 3 x 8 bit meshlet local vertices
+};
+
+// Splits a triangle list into meshlets of at most MESHLET_MAX_VERTICES / MESHLET_MAX_TRIANGLES,
+// in index buffer order, so a vertex cache optimized index buffer gives spatially tight meshlets.
+MeshletMesh BuildMeshlets(const uint32_t* _indices, size_t _indexCount, const Vertex* _vertices, size_t _vertexCount);
+
+// Frustum planes (xyz inward normal, w distance) in the space _viewProjection transforms from, for [0, 1] depth.
+void ExtractFrustumPlanes(const glm::mat4& _viewProjection, glm::vec4 _planes[6]);
+
+// CPU version of the test in shaders/meshlet_cull.comp, _cameraPosition in the meshlet's space.
+bool IsMeshletVisible(const Meshlet& _meshlet, const glm::vec4 _planes[6], const glm::vec3& _cameraPosition);
@@ -0,0 +1,664 @@
+﻿#include "ObjLoader.h"
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+
+// Parsing runs in three parallel passes over the same chunks of the mapped file :
+//	1. count	- records per chunk, triangulated corner count, shape boundaries
+//	2. attribs	- v / vt / vn parsed straight into the final attrib_t arrays
+//	3. faces	- f parsed and triangulated straight into the final shape_t index arrays
+// Nothing is allocated per line, and the only per-chunk allocations are the shape marks,
+// so peak memory is the mapped file plus the output arrays.
+
+namespace
+{
+	// chunks smaller than this are not worth a task of their own
+	const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+	// same limit as tinyobj's num_face_vertices (unsigned char)
+	const int MAX_FACE_CORNERS = 255;
+
+	// "o" / "g" record : a new shape starts at this chunk-local triangulated corner
+	struct ShapeMark
+	{
+		size_t triangleCorner;
+		size_t position;
+		std::string name;
+	};
+
+	struct ObjChunk
+	{
+		const char* begin = nullptr;
+		const char* end = nullptr;
+
+		// pass 1
+		size_t positionCount = 0;
+		size_t texcoordCount = 0;
+		size_t normalCount = 0;
+		size_t triangleCornerCount = 0;
+		size_t degenerateFaces = 0;
+		std::vector<ShapeMark> shapeMarks;
+
+		// prefix sums over the previous chunks
+		size_t positionBase = 0;
+		size_t texcoordBase = 0;
+		size_t normalBase = 0;
+		size_t triangleCornerBase = 0;
+
+		// pass 3, first corner of each quad skipped for an out of range position (6 corners left unwritten)
+		std::vector<size_t> invalidQuads;
+	};
+
+	// contiguous range of triangulated corners that becomes one shape_t
+	struct ShapeSegment
+	{
+		size_t begin;
+		size_t end;
+		std::string name;
+
+		// positions declared before the shape ends, tinyobj checks the quads of the shape against these
+		size_t positionCount;
+	};
+
+	enum class LineType
+	{
+		Position,
+		Texcoord,
+		Normal,
+		Face,
+		Shape,
+		Other
+	};
+
+	inline bool isSpace(char _c)
+	{
+		return _c == ' ' || _c == '\t';
+	}
+
+	inline const char* skipSpaces(const char* _cursor, const char* _end)
+	{
+		while (_cursor < _end && isSpace(*_cursor))
+			++_cursor;
+
+		return _cursor;
+	}
+
+	// _cursor is moved past the record keyword
+	LineType classifyLine(const char*& _cursor, const char* _end)
+	{
+		const size_t length = _end - _cursor;
+		if (length == 0)
+			return LineType::Other;
+
+		const char command = _cursor[0];
+
+		if (command == 'v' && length >= 2)
+		{
+			if (isSpace(_cursor[1]))
+			{
+				_cursor += 2;
+				return LineType::Position;
+			}
+
+			if (length >= 3 && isSpace(_cursor[2]))
+			{
+				if (_cursor[1] == 't')
+				{
+					_cursor += 3;
+					return LineType::Texcoord;
+				}
+
+				if (_cursor[1] == 'n')
+				{
+					_cursor += 3;
+					return LineType::Normal;
+				}
+			}
+		}
+		else if (command == 'f' && length >= 2 && isSpace(_cursor[1]))
+		{
+			_cursor += 2;
+			return LineType::Face;
+		}
+		else if ((command == 'o' || command == 'g') && (length == 1 || isSpace(_cursor[1])))
+		{
+			_cursor += 1;
+			return LineType::Shape;
+		}
+
+		// comments, mtllib, usemtl, s, l, p ...
+		return LineType::Other;
+	}
+
+	// Calls _func(lineType, cursor, lineEnd) for every line in the chunk, cursor placed after the keyword.
+	template<typename Func>
+	void forEachLine(const ObjChunk& _chunk, Func&& _func)
+	{
+		const char* cursor = _chunk.begin;
+
+		while (cursor < _chunk.end)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(cursor, '\n', _chunk.end - cursor));
+			if (lineEnd == nullptr)
+				lineEnd = _chunk.end;
+
+			const char* nextLine = (lineEnd < _chunk.end) ? lineEnd + 1 : lineEnd;
+
+			if (lineEnd > cursor && lineEnd[-1] == '\r')
+				--lineEnd;
+
+			const char* lineCursor = skipSpaces(cursor, lineEnd);
+			LineType type = classifyLine(lineCursor, lineEnd);
+
+			_func(type, lineCursor, lineEnd);
+
+			cursor = nextLine;
+		}
+	}
+
+	bool parseReal(const char*& _cursor, const char* _end, tinyobj::real_t& _value)
+	{
+		const char* cursor = skipSpaces(_cursor, _end);
+
+		// from_chars does not accept a leading '+'
+		if (cursor < _end && *cursor == '+')
+			++cursor;
+
+		std::from_chars_result result = std::from_chars(cursor, _end, _value);
+		if (result.ec != std::errc())
+			return false;
+
+		_cursor = result.ptr;
+		return true;
+	}
+
+	bool parseInt(const char*& _cursor, const char* _end, int& _value)
+	{
+		const char* cursor = _cursor;
+
+		if (cursor < _end && *cursor == '+')
+			++cursor;
+
+		std::from_chars_result result = std::from_chars(cursor, _end, _value);
+		if (result.ec != std::errc())
+			return false;
+
+		_cursor = result.ptr;
+		return true;
+	}
+
+	// raw OBJ indices of one face corner, 0 = absent
+	struct RawCorner
+	{
+		int position;
+		int texcoord;
+		int normal;
+	};
+
+	// Tokenizes an "f" record into _corners (MAX_FACE_CORNERS entries on the stack).
+	// Returns the corner count, or 0 if the face is malformed or degenerate.
+	// Pass 1 and pass 3 both go through here so they agree on which faces exist.
+	int scanFace(const char* _cursor, const char* _end, RawCorner* _corners)
+	{
+		int count = 0;
+
+		while (true)
+		{
+			_cursor = skipSpaces(_cursor, _end);
+			if (_cursor >= _end)
+				break;
+
+			if (count == MAX_FACE_CORNERS)
+				return 0;
+
+			// v, v/vt, v//vn, v/vt/vn
+			RawCorner corner = { 0, 0, 0 };
+			if (parseInt(_cursor, _end, corner.position) == false || corner.position == 0)
+				return 0;
+
+			if (_cursor < _end && *_cursor == '/')
+			{
+				++_cursor;
+				if (_cursor < _end && *_cursor != '/')
+					parseInt(_cursor, _end, corner.texcoord);
+
+				if (_cursor < _end && *_cursor == '/')
+				{
+					++_cursor;
+					parseInt(_cursor, _end, corner.normal);
+				}
+			}
+
+			_corners[count++] = corner;
+
+			// anything glued to the token that we do not understand
+			while (_cursor < _end && isSpace(*_cursor) == false)
+				++_cursor;
+		}
+
+		return (count >= 3) ? count : 0;
+	}
+
+	// OBJ index (1-based, negative = relative to the records seen so far) -> 0-based global index, -1 if absent
+	inline int resolveIndex(int _raw, size_t _seenCount)
+	{
+		if (_raw > 0)
+			return _raw - 1;
+
+		if (_raw < 0)
+			return static_cast<int>(_seenCount) + _raw;
+
+		return -1;
+	}
+
+	void countChunk(ObjChunk& _chunk)
+	{
+		RawCorner corners[MAX_FACE_CORNERS];
+
+		forEachLine(_chunk, [&_chunk, &corners](LineType _type, const char* _cursor, const char* _end)
+			{
+				switch (_type)
+				{
+				case LineType::Position:
+					_chunk.positionCount++;
+					break;
+				case LineType::Texcoord:
+					_chunk.texcoordCount++;
+					break;
+				case LineType::Normal:
+					_chunk.normalCount++;
+					break;
+				case LineType::Face:
+				{
+					int cornerCount = scanFace(_cursor, _end, corners);
+					if (cornerCount == 0)
+						_chunk.degenerateFaces++;
+					else
+						_chunk.triangleCornerCount += 3 * static_cast<size_t>(cornerCount - 2);
+					break;
+				}
+				case LineType::Shape:
+				{
+					const char* nameBegin = skipSpaces(_cursor, _end);
+					const char* nameEnd = _end;
+					while (nameEnd > nameBegin && isSpace(nameEnd[-1]))
+						--nameEnd;
+
+					_chunk.shapeMarks.push_back({ _chunk.triangleCornerCount, _chunk.positionCount, std::string(nameBegin, nameEnd) });
+					break;
+				}
+				default:
+					break;
+				}
+			});
+	}
+
+	void parseAttributes(const ObjChunk& _chunk, tinyobj::attrib_t& _attrib)
+	{
+		tinyobj::real_t* positions = _attrib.vertices.data() + 3 * _chunk.positionBase;
+		tinyobj::real_t* texcoords = _attrib.texcoords.data() + 2 * _chunk.texcoordBase;
+		tinyobj::real_t* normals = _attrib.normals.data() + 3 * _chunk.normalBase;
+
+		forEachLine(_chunk, [&](LineType _type, const char* _cursor, const char* _end)
+			{
+				// missing components stay 0, like tinyobj
+				switch (_type)
+				{
+				case LineType::Position:
+					positions[0] = positions[1] = positions[2] = 0.0f;
+					parseReal(_cursor, _end, positions[0]);
+					parseReal(_cursor, _end, positions[1]);
+					parseReal(_cursor, _end, positions[2]);
+					positions += 3;
+					break;
+				case LineType::Texcoord:
+					texcoords[0] = texcoords[1] = 0.0f;
+					parseReal(_cursor, _end, texcoords[0]);
+					parseReal(_cursor, _end, texcoords[1]);
+					texcoords += 2;
+					break;
+				case LineType::Normal:
+					normals[0] = normals[1] = normals[2] = 0.0f;
+					parseReal(_cursor, _end, normals[0]);
+					parseReal(_cursor, _end, normals[1]);
+					parseReal(_cursor, _end, normals[2]);
+					normals += 3;
+					break;
+				default:
+					break;
+				}
+			});
+	}
+
+	// Writes triangulated corners sequentially across shape boundaries.
+	class CornerWriter
+	{
+	public:
+		CornerWriter(std::vector<tinyobj::shape_t>& _shapes, const std::vector<ShapeSegment>& _segments, size_t _firstCorner)
+			: shapes(_shapes), segments(_segments), corner(_firstCorner)
+		{
+			// first segment whose end is past _firstCorner
+			auto it = std::upper_bound(segments.begin(), segments.end(), corner, [](size_t _corner, const ShapeSegment& _segment) { return _corner < _segment.end; });
+			segment = static_cast<size_t>(it - segments.begin());
+		}
+
+		void write(const tinyobj::index_t& _index)
+		{
+			while (corner >= segments[segment].end)
+				segment++;
+
+			shapes[segment].mesh.indices[corner - segments[segment].begin] = _index;
+			corner++;
+		}
+
+		// position count of the shape the next corner goes to
+		size_t positionLimit()
+		{
+			while (corner >= segments[segment].end)
+				segment++;
+
+			return segments[segment].positionCount;
+		}
+
+		// leaves _count corners unwritten, returns the first one
+		size_t skip(size_t _count)
+		{
+			const size_t first = corner;
+			corner += _count;
+			return first;
+		}
+
+	private:
+		std::vector<tinyobj::shape_t>& shapes;
+		const std::vector<ShapeSegment>& segments;
+		size_t corner;
+		size_t segment = 0;
+	};
+
+	void parseFaces(ObjChunk& _chunk, const std::vector<tinyobj::real_t>& _positions, std::vector<tinyobj::shape_t>& _shapes, const std::vector<ShapeSegment>& _segments)
+	{
+		if (_chunk.triangleCornerCount == 0)
+			return;
+
+		CornerWriter writer(_shapes, _segments, _chunk.triangleCornerBase);
+
+		// records seen so far, for relative indices
+		size_t positionsSeen = _chunk.positionBase;
+		size_t texcoordsSeen = _chunk.texcoordBase;
+		size_t normalsSeen = _chunk.normalBase;
+
+		RawCorner rawCorners[MAX_FACE_CORNERS];
+		tinyobj::index_t face[MAX_FACE_CORNERS];
+
+		forEachLine(_chunk, [&](LineType _type, const char* _cursor, const char* _end)
+			{
+				if (_type == LineType::Position)
+					positionsSeen++;
+				else if (_type == LineType::Texcoord)
+					texcoordsSeen++;
+				else if (_type == LineType::Normal)
+					normalsSeen++;
+
+				if (_type != LineType::Face)
+					return;
+
+				int faceSize = scanFace(_cursor, _end, rawCorners);
+				if (faceSize == 0)
+					return;
+
+				for (int i = 0; i < faceSize; i++)
+				{
+					face[i].vertex_index = resolveIndex(rawCorners[i].position, positionsSeen);
+					face[i].texcoord_index = resolveIndex(rawCorners[i].texcoord, texcoordsSeen);
+					face[i].normal_index = resolveIndex(rawCorners[i].normal, normalsSeen);
+				}
+
+				if (faceSize == 3)
+				{
+					writer.write(face[0]);
+					writer.write(face[1]);
+					writer.write(face[2]);
+				}
+				else if (faceSize == 4)
+				{
+					const size_t positionLimit = writer.positionLimit();
+
+					bool inRange = true;
+					for (int i = 0; i < 4; i++)
+					{
+						if (face[i].vertex_index < 0 || static_cast<size_t>(face[i].vertex_index) >= positionLimit)
+							inRange = false;
+					}
+
+					// dropped like tinyobj does, removed from the shapes once every chunk is parsed
+					if (inRange == false)
+					{
+						_chunk.invalidQuads.push_back(writer.skip(6));
+						return;
+					}
+
+					// split on the shorter diagonal, same rule as tinyobj
+					const tinyobj::real_t* v0 = &_positions[3 * face[0].vertex_index];
+					const tinyobj::real_t* v1 = &_positions[3 * face[1].vertex_index];
+					const tinyobj::real_t* v2 = &_positions[3 * face[2].vertex_index];
+					const tinyobj::real_t* v3 = &_positions[3 * face[3].vertex_index];
+
+					tinyobj::real_t sqr02 = (v2[0] - v0[0]) * (v2[0] - v0[0]) + (v2[1] - v0[1]) * (v2[1] - v0[1]) + (v2[2] - v0[2]) * (v2[2] - v0[2]);
+					tinyobj::real_t sqr13 = (v3[0] - v1[0]) * (v3[0] - v1[0]) + (v3[1] - v1[1]) * (v3[1] - v1[1]) + (v3[2] - v1[2]) * (v3[2] - v1[2]);
+					const bool split02 = sqr02 < sqr13;
+
+					if (split02 == true)
+					{
+						// [0, 1, 2], [0, 2, 3]
+						writer.write(face[0]); writer.write(face[1]); writer.write(face[2]);
+						writer.write(face[0]); writer.write(face[2]); writer.write(face[3]);
+					}
+					else
+					{
+						// [0, 1, 3], [1, 2, 3]
+						writer.write(face[0]); writer.write(face[1]); writer.write(face[3]);
+						writer.write(face[1]); writer.write(face[2]); writer.write(face[3]);
+					}
+				}
+				else
+				{
+					// fan
+					for (int i = 1; i + 1 < faceSize; i++)
+					{
+						writer.write(face[0]);
+						writer.write(face[i]);
+						writer.write(face[i + 1]);
+					}
+				}
+			});
+	}
+
+	// closes the 6 corner gaps parseFaces() left for the skipped quads, a quad never straddles two shapes.
+	// shapes left without any face are removed like tinyobj does, except the last one which tinyobj keeps
+	void removeInvalidQuads(std::vector<tinyobj::shape_t>& _shapes, const std::vector<ShapeSegment>& _segments, const std::vector<size_t>& _invalidQuads)
+	{
+		size_t next = 0;
+
+		for (size_t i = 0; i < _shapes.size(); i++)
+		{
+			tinyobj::mesh_t& mesh = _shapes[i].mesh;
+			size_t written = 0;
+
+			for (size_t corner = _segments[i].begin; corner < _segments[i].end; corner += 3)
+			{
+				if (next < _invalidQuads.size() && corner >= _invalidQuads[next])
+				{
+					if (corner + 3 == _invalidQuads[next] + 6)
+						next++;
+
+					continue;
+				}
+
+				const size_t source = corner - _segments[i].begin;
+				mesh.indices[written + 0] = mesh.indices[source + 0];
+				mesh.indices[written + 1] = mesh.indices[source + 1];
+				mesh.indices[written + 2] = mesh.indices[source + 2];
+				written += 3;
+			}
+
+			mesh.indices.resize(written);
+			mesh.num_face_vertices.resize(written / 3);
+			mesh.material_ids.resize(written / 3);
+			mesh.smoothing_group_ids.resize(written / 3);
+		}
+
+		if (_shapes.empty() == true)
+			return;
+
+		const auto last = std::remove_if(_shapes.begin(), _shapes.end() - 1, [](const tinyobj::shape_t& _shape) { return _shape.mesh.indices.empty(); });
+		_shapes.erase(last, _shapes.end() - 1);
+	}
+}
+
+bool LoadObjParallel(tinyobj::attrib_t* _attrib, std::vector<tinyobj::shape_t>* _shapes, std::string* _warn, std::string* _err, const char* _filename, ThreadPool& _threadPool)
+{
+	MappedFile file;
+
+	if (file.open(_filename) == false)
+	{
+		if (_err != nullptr)
+			(*_err) += "Cannot open file [" + std::string(_filename) + "]\n";
+
+		return false;
+	}
+
+	return ParseObjParallel(_attrib, _shapes, _warn, _err, file.data(), file.size(), _threadPool);
+}
+
+bool ParseObjParallel(tinyobj::attrib_t* _attrib, std::vector<tinyobj::shape_t>* _shapes, std::string* _warn, std::string* _err, const char* _data, size_t _size, ThreadPool& _threadPool)
+{
+	if (_attrib == nullptr || _shapes == nullptr)
+	{
+		if (_err != nullptr)
+			(*_err) += "Invalid argument : attrib and shapes must not be null\n";
+
+		return false;
+	}
+
+	*_attrib = tinyobj::attrib_t();
+	_shapes->clear();
+
+	// split at line boundaries, a few chunks per worker so uneven chunks balance out
+	size_t chunkCount = std::min<size_t>(_size / MIN_CHUNK_SIZE, static_cast<size_t>(_threadPool.getThreadCount()) * 4);
+	chunkCount = std::max<size_t>(chunkCount, 1);
+
+	std::vector<ObjChunk> chunks(chunkCount);
+	{
+		const char* end = _data + _size;
+		const char* begin = _data;
+
+		for (size_t i = 0; i < chunkCount; i++)
+		{
+			const char* split = end;
+
+			if (i + 1 < chunkCount)
+			{
+				split = std::max(begin, _data + _size * (i + 1) / chunkCount);
+
+				const char* newline = static_cast<const char*>(memchr(split, '\n', end - split));
+				split = (newline != nullptr) ? newline + 1 : end;
+			}
+
+			chunks[i].begin = begin;
+			chunks[i].end = split;
+			begin = split;
+		}
+	}
+
+	// pass 1
+	_threadPool.parallelFor(chunkCount, [&chunks](size_t _i) { countChunk(chunks[_i]); });
+
+	size_t positionCount = 0, texcoordCount = 0, normalCount = 0, triangleCornerCount = 0;
+	size_t degenerateFaces = 0;
+
+	for (ObjChunk& chunk : chunks)
+	{
+		chunk.positionBase = positionCount;
+		chunk.texcoordBase = texcoordCount;
+		chunk.normalBase = normalCount;
+		chunk.triangleCornerBase = triangleCornerCount;
+
+		positionCount += chunk.positionCount;
+		texcoordCount += chunk.texcoordCount;
+		normalCount += chunk.normalCount;
+		triangleCornerCount += chunk.triangleCornerCount;
+		degenerateFaces += chunk.degenerateFaces;
+	}
+
+	// shape boundaries from "o" / "g" records; empty groups only rename the shape that follows
+	std::vector<ShapeSegment> segments;
+	{
+		size_t segmentBegin = 0;
+		std::string segmentName;
+
+		for (const ObjChunk& chunk : chunks)
+		{
+			for (const ShapeMark& mark : chunk.shapeMarks)
+			{
+				size_t boundary = chunk.triangleCornerBase + mark.triangleCorner;
+
+				if (boundary > segmentBegin)
+					segments.push_back({ segmentBegin, boundary, segmentName, chunk.positionBase + mark.position });
+
+				segmentBegin = boundary;
+				segmentName = mark.name;
+			}
+		}
+
+		if (triangleCornerCount > segmentBegin)
+			segments.push_back({ segmentBegin, triangleCornerCount, segmentName, positionCount });
+	}
+
+	// every output array is allocated exactly once, at its final size
+	_attrib->vertices.resize(3 * positionCount);
+	_attrib->texcoords.resize(2 * texcoordCount);
+	_attrib->normals.resize(3 * normalCount);
+
+	_shapes->resize(segments.size());
+	for (size_t i = 0; i < segments.size(); i++)
+	{
+		tinyobj::shape_t& shape = (*_shapes)[i];
+		size_t triangleCount = (segments[i].end - segments[i].begin) / 3;
+
+		shape.name = segments[i].name;
+		shape.mesh.indices.resize(segments[i].end - segments[i].begin);
+		shape.mesh.num_face_vertices.assign(triangleCount, 3);
+		shape.mesh.material_ids.assign(triangleCount, -1);
+		shape.mesh.smoothing_group_ids.assign(triangleCount, 0);
+	}
+
+	// pass 2 : quad triangulation in pass 3 needs every position in place
+	_threadPool.parallelFor(chunkCount, [&chunks, _attrib](size_t _i) { parseAttributes(chunks[_i], *_attrib); });
+
+	// pass 3
+	_threadPool.parallelFor(chunkCount, [&chunks, &segments, _attrib, _shapes](size_t _i) { parseFaces(chunks[_i], _attrib->vertices, *_shapes, segments); });
+
+	// chunks are in file order, so the skipped quads are sorted
+	std::vector<size_t> invalidQuads;
+	for (const ObjChunk& chunk : chunks)
+		invalidQuads.insert(invalidQuads.end(), chunk.invalidQuads.begin(), chunk.invalidQuads.end());
+
+	if (invalidQuads.empty() == false)
+		removeInvalidQuads(*_shapes, segments, invalidQuads);
+
+	if (_warn != nullptr)
+	{
+		if (degenerateFaces > 0)
+			(*_warn) += "Degenerated face found (" + std::to_string(degenerateFaces) + ").\n";
+
+		if (invalidQuads.empty() == false)
+			(*_warn) += "Face with invalid vertex index found (" + std::to_string(invalidQuads.size()) + ").\n";
+	}
+
+	return true;
+}
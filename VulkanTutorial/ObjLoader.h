@@ -0,0 +1,23 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+class ThreadPool;
+
+// Multithreaded replacement for tinyobj::LoadObj.
+//
+// The file is memory-mapped and split at line boundaries into chunks that are parsed concurrently on _threadPool,
+// straight from the mapped bytes into the same attrib_t / shape_t layout tinyobj produces.
+// Only the records loadModel() needs are handled :
+//	v / vt / vn	- positions, texture coordinates, normals
+//	f			- faces (triangulated like tinyobj : quads split on the shorter diagonal or dropped when a position is out of range,
+//				  larger polygons fanned)
+//	o / g		- start a new shape
+// Materials (mtllib / usemtl), lines, points and smoothing groups are ignored,
+// so material_ids are -1 and smoothing_group_ids are 0.
+bool LoadObjParallel(tinyobj::attrib_t* _attrib, std::vector<tinyobj::shape_t>* _shapes, std::string* _warn, std::string* _err, const char* _filename, ThreadPool& _threadPool);
+
+// Same as LoadObjParallel, parsing OBJ text that is already in memory.
+bool ParseObjParallel(tinyobj::attrib_t* _attrib, std::vector<tinyobj::shape_t>* _shapes, std::string* _warn, std::string* _err, const char* _data, size_t _size, ThreadPool& _threadPool);
@@ -0,0 +1,88 @@
+﻿#include "StagingRing.h"
+
+#include <algorithm>
+
+void StagingRing::create(VkBuffer _buffer, char* _mappedData, VkDeviceSize _size)
+{
+	buffer = _buffer;
+	mappedData = _mappedData;
+	size = _size;
+
+	head = 0;
+	tail = 0;
+	empty = true;
+	unsubmitted = false;
+	submissions.clear();
+	peakUsedSize = 0;
+}
+
+bool StagingRing::allocate(VkDeviceSize _size, VkDeviceSize _alignment, VkDeviceSize& _offset)
+{
+	if (_size == 0 || _size > size)
+		return false;
+
+	if (empty == true)
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	VkDeviceSize offset = (head + _alignment - 1) / _alignment * _alignment;
+
+	if (empty == true || head > tail)
+	{
+		// free : [head, size) then [0, tail), the skipped end is freed with the wrapping submission
+		if (offset + _size > size)
+		{
+			offset = 0;
+			if (_size > tail && empty == false)
+				return false;
+		}
+	}
+	else if (head < tail)
+	{
+		// wrapped, free : [head, tail)
+		if (offset + _size > tail)
+			return false;
+	}
+	else
+		return false; // full
+
+	_offset = offset;
+	head = offset + _size;
+	empty = false;
+	unsubmitted = true;
+
+	peakUsedSize = std::max(peakUsedSize, getUsedSize());
+
+	return true;
+}
+
+void StagingRing::submit(uint64_t _serial)
+{
+	if (unsubmitted == false)
+		return;
+
+	submissions.push_back({ _serial, head });
+	unsubmitted = false;
+}
+
+void StagingRing::retire(uint64_t _serial)
+{
+	while (submissions.empty() == false && submissions.front().serial <= _serial)
+	{
+		tail = submissions.front().end;
+		submissions.pop_front();
+	}
+
+	if (submissions.empty() == true && unsubmitted == false)
+		empty = true;
+}
+
+VkDeviceSize StagingRing::getUsedSize() const
+{
+	if (empty == true)
+		return 0;
+
+	return (head > tail) ? head - tail : size - tail + head;
+}
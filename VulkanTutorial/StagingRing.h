@@ -0,0 +1,54 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+
+// Persistently mapped host-visible buffer range that uploads suballocate their staging memory from, in ring order.
+//
+// Allocations made between two submit() calls belong to that submission and are freed together
+// once retire() is told its serial has completed on the GPU, so staging memory stays bounded by the ring size
+// without any per-upload buffer creation, mapping or freeing.
+class StagingRing
+{
+public:
+	// _mappedData : the mapped memory of _buffer (host visible and coherent, at least _size bytes), both stay owned by the caller
+	void create(VkBuffer _buffer, char* _mappedData, VkDeviceSize _size);
+
+	// false when the free space can't hold _size bytes right now, and always for 0 bytes
+	bool allocate(VkDeviceSize _size, VkDeviceSize _alignment, VkDeviceSize& _offset);
+
+	// the allocations since the previous submit() are in use until _serial retires
+	void submit(uint64_t _serial);
+
+	// frees the allocations of every submission up to and including _serial
+	void retire(uint64_t _serial);
+
+	VkBuffer getBuffer() const { return buffer; }
+	char* getMappedData() const { return mappedData; }
+	VkDeviceSize getSize() const { return size; }
+
+	VkDeviceSize getUsedSize() const;
+	VkDeviceSize getPeakUsedSize() const { return peakUsedSize; }
+
+private:
+	struct Submission
+	{
+		uint64_t serial;
+		VkDeviceSize end; // head after its last allocation
+	};
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	char* mappedData = nullptr;
+	VkDeviceSize size = 0;
+
+	// in use : [tail, head), wrapping around the end
+	VkDeviceSize head = 0;
+	VkDeviceSize tail = 0;
+	bool empty = true;
+	bool unsubmitted = false; // allocations not yet covered by submit()
+
+	std::deque<Submission> submissions;
+
+	VkDeviceSize peakUsedSize = 0;
+};
@@ -0,0 +1,95 @@
+﻿#include "StartupTimeline.h"
+
+#include <algorithm>
+#include <iomanip>
+
+StartupTimeline::StartupTimeline()
+	: startTime(std::chrono::steady_clock::now())
+{
+}
+
+uint32_t StartupTimeline::begin(const std::string& _name, bool _mainThread, uint32_t _dependency)
+{
+	const double start = now();
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const uint32_t stage = static_cast<uint32_t>(stages.size());
+	stages.push_back(Stage{ _name, _mainThread, (_mainThread == true) ? lastMainStage : NO_STAGE, _dependency, start, start });
+
+	if (_mainThread == true)
+		lastMainStage = stage;
+
+	return stage;
+}
+
+void StartupTimeline::end(uint32_t _stage)
+{
+	const double end = now();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stages[_stage].end = end;
+}
+
+double StartupTimeline::now() const
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void StartupTimeline::report(std::ostream& _output) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (stages.empty() == true)
+		return;
+
+	const std::ios::fmtflags flags = _output.flags();
+	_output << std::fixed << std::setprecision(1);
+
+	_output << "startup timeline (ms) :" << std::endl;
+	for (const Stage& stage : stages)
+	{
+		_output << std::setw(9) << stage.start << std::setw(9) << stage.end << std::setw(9) << (stage.end - stage.start)
+			<< ((stage.mainThread == true) ? "  main    " : "  worker  ") << stage.name << std::endl;
+	}
+
+	// back from the stage that finished last
+	uint32_t current = 0;
+	for (uint32_t i = 1; i < stages.size(); i++)
+	{
+		if (stages[i].end > stages[current].end)
+			current = i;
+	}
+
+	std::vector<uint32_t> path;
+	while (current != NO_STAGE)
+	{
+		path.push_back(current);
+
+		const uint32_t previous = stages[current].previous;
+		const uint32_t dependency = stages[current].dependency;
+
+		if (previous == NO_STAGE)
+			current = dependency;
+		else if (dependency == NO_STAGE)
+			current = previous;
+		else
+			current = (stages[dependency].end > stages[previous].end) ? dependency : previous;
+	}
+	std::reverse(path.begin(), path.end());
+
+	double busy = 0.0;
+	_output << "critical path :";
+	for (size_t i = 0; i < path.size(); i++)
+	{
+		const Stage& stage = stages[path[i]];
+		busy += stage.end - stage.start;
+		_output << ((i == 0) ? " " : " -> ") << stage.name << " (" << (stage.end - stage.start) << ")";
+	}
+	_output << std::endl;
+
+	// the rest is waiting between stages (queueing, event handling)
+	_output << "critical path length : " << stages[path.back()].end << " ms, " << busy << " of it in stages" << std::endl;
+
+	_output.flags(flags);
+}
@@ -0,0 +1,57 @@
+﻿#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Records the stages of startup across threads and reports their timing and the critical path.
+//
+// Stages on the main thread implicitly follow the previous main thread stage,
+// any other ordering (a stage waiting for a worker's result) is passed in as a dependency.
+// The critical path is walked back from the stage that finished last, each step going to
+// whichever predecessor finished later, so it names the chain that actually gated startup.
+class StartupTimeline
+{
+public:
+	static const uint32_t NO_STAGE = UINT32_MAX;
+
+	StartupTimeline();
+
+	// thread safe, returns the stage to pass to end() or as a later stage's dependency
+	uint32_t begin(const std::string& _name, bool _mainThread, uint32_t _dependency = NO_STAGE);
+	void end(uint32_t _stage);
+
+	template<typename F>
+	uint32_t time(const std::string& _name, bool _mainThread, F&& _function, uint32_t _dependency = NO_STAGE)
+	{
+		const uint32_t stage = begin(_name, _mainThread, _dependency);
+		_function();
+		end(stage);
+
+		return stage;
+	}
+
+	// milliseconds since construction
+	double now() const;
+
+	void report(std::ostream& _output) const;
+
+private:
+	struct Stage
+	{
+		std::string name;
+		bool mainThread;
+		uint32_t previous; // previous main thread stage
+		uint32_t dependency;
+		double start;
+		double end;
+	};
+
+	std::chrono::steady_clock::time_point startTime;
+
+	mutable std::mutex mutex;
+	std::vector<Stage> stages;
+	uint32_t lastMainStage = NO_STAGE;
+};
@@ -0,0 +1,99 @@
+﻿#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+
+ThreadPool::ThreadPool(uint32_t _threadCount)
+{
+	if (_threadCount == 0)
+		_threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	workers.reserve(_threadCount);
+	for (uint32_t i = 0; i < _threadCount; i++)
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	condition.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::parallelFor(size_t _count, const std::function<void(size_t)>& _func)
+{
+	if (_count == 0)
+		return;
+
+	// single item : no reason to pay for a hand-off
+	if (_count == 1)
+	{
+		_func(0);
+		return;
+	}
+
+	std::vector<std::future<void>> results;
+	results.reserve(_count);
+
+	for (size_t i = 0; i < _count; i++)
+		results.push_back(enqueue([&_func, i]() { _func(i); }));
+
+	// wait for everything first so no task still references _func when we throw.
+	// the caller runs queued tasks meanwhile, so a task running on a worker can call parallelFor too
+	for (auto& result : results)
+	{
+		while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			// nothing queued : the rest is already running on other workers
+			if (runPendingTask() == false)
+				result.wait();
+		}
+	}
+
+	for (auto& result : results)
+		result.get();
+}
+
+bool ThreadPool::runPendingTask()
+{
+	std::function<void()> task;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (tasks.empty() == true)
+			return false;
+
+		task = std::move(tasks.front());
+		tasks.pop();
+	}
+
+	task();
+
+	return true;
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			condition.wait(lock, [this]() { return stopping == true || tasks.empty() == false; });
+
+			if (stopping == true && tasks.empty() == true)
+				return;
+
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,61 @@
+﻿#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads consuming a FIFO task queue.
+class ThreadPool
+{
+public:
+	// _threadCount == 0 : one worker per hardware thread
+	explicit ThreadPool(uint32_t _threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	template<typename F>
+	auto enqueue(F&& _task) -> std::future<decltype(_task())>
+	{
+		using ResultType = decltype(_task());
+
+		auto packagedTask = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(_task));
+		std::future<ResultType> result = packagedTask->get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			tasks.emplace([packagedTask]() { (*packagedTask)(); });
+		}
+		condition.notify_one();
+
+		return result;
+	}
+
+	// Run _func(i) for every i in [0, _count) and block until all calls have returned.
+	// Exceptions thrown by _func are rethrown on the calling thread.
+	// Safe to call from a task, the caller works through the queue while it waits.
+	void parallelFor(size_t _count, const std::function<void(size_t)>& _func);
+
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+	// runs the next queued task on the calling thread, false if the queue is empty
+	bool runPendingTask();
+
+	void workerLoop();
+
+private:
+	std::vector<std::thread> workers;
+
+	std::queue<std::function<void()>> tasks;
+	std::mutex queueMutex;
+	std::condition_variable condition;
+
+	bool stopping = false;
+};
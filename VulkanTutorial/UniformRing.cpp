@@ -0,0 +1,39 @@
+﻿#include "UniformRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+void UniformRing::create(VkBuffer _buffer, char* _mappedData, uint32_t _frameCount, VkDeviceSize _frameSize, VkDeviceSize _alignment)
+{
+	buffer = _buffer;
+	mappedData = _mappedData;
+	frameCount = _frameCount;
+	frameSize = _frameSize;
+	alignment = std::max<VkDeviceSize>(_alignment, 1);
+
+	frame = 0;
+	frameUsedSize = 0;
+	peakFrameUsedSize = 0;
+}
+
+void UniformRing::beginFrame(uint32_t _frame)
+{
+	frame = _frame % frameCount;
+	frameUsedSize = 0;
+}
+
+uint32_t UniformRing::push(const void* _data, VkDeviceSize _size)
+{
+	const VkDeviceSize alignedSize = getAlignedSize(_size);
+	if (frameUsedSize + alignedSize > frameSize)
+		throw std::runtime_error("uniform ring frame region is full!");
+
+	const VkDeviceSize offset = frame * frameSize + frameUsedSize;
+	memcpy(mappedData + offset, _data, static_cast<size_t>(_size));
+
+	frameUsedSize += alignedSize;
+	peakFrameUsedSize = std::max(peakFrameUsedSize, frameUsedSize);
+
+	return static_cast<uint32_t>(offset);
+}
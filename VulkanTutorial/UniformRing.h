@@ -0,0 +1,46 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// One persistently mapped uniform buffer split into a region per frame in flight, bound through
+// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptors : the dynamic offset picks the frame's region and the slot in it.
+//
+// Writing a frame's uniforms is a plain store into its region, no map / unmap or per-frame buffer.
+// Slots are pushed in order from the start of the region, push() returns the dynamic offset
+// the frame's command buffer has to bind them at.
+class UniformRing
+{
+public:
+	// _mappedData : the mapped memory of _buffer (host visible and coherent, _frameCount * _frameSize bytes), both stay owned by the caller
+	// _frameSize : a multiple of _alignment, the device's minUniformBufferOffsetAlignment
+	void create(VkBuffer _buffer, char* _mappedData, uint32_t _frameCount, VkDeviceSize _frameSize, VkDeviceSize _alignment);
+
+	// empties _frame's region for new pushes, the GPU must be done with its previous contents
+	void beginFrame(uint32_t _frame);
+
+	// copies _size bytes into the region of the current frame, returns the dynamic offset to bind them at
+	uint32_t push(const void* _data, VkDeviceSize _size);
+
+	template<typename T>
+	uint32_t push(const T& _value) { return push(&_value, sizeof(T)); }
+
+	// what a push of _size bytes takes in a region
+	VkDeviceSize getAlignedSize(VkDeviceSize _size) const { return (_size + alignment - 1) / alignment * alignment; }
+
+	VkBuffer getBuffer() const { return buffer; }
+	VkDeviceSize getFrameSize() const { return frameSize; }
+	VkDeviceSize getPeakFrameUsedSize() const { return peakFrameUsedSize; }
+
+private:
+	VkBuffer buffer = VK_NULL_HANDLE;
+	char* mappedData = nullptr;
+	uint32_t frameCount = 0;
+	VkDeviceSize frameSize = 0;
+	VkDeviceSize alignment = 1;
+
+	uint32_t frame = 0;
+	VkDeviceSize frameUsedSize = 0;
+
+	VkDeviceSize peakFrameUsedSize = 0;
+};
@@ -0,0 +1,319 @@
+﻿#include "UploadBatch.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+void UploadBatch::create(VkDevice _device, VkQueue _graphicsQueue, uint32_t _graphicsFamily, VkCommandPool _graphicsCommandPool,
+	VkQueue _transferQueue, uint32_t _transferFamily, VkCommandPool _transferCommandPool,
+	DeviceMemoryAllocator* _memoryAllocator, VkBuffer _stagingBuffer, const DeviceAllocation& _stagingMemory, VkDeviceSize _stagingSize)
+{
+	device = _device;
+	memoryAllocator = _memoryAllocator;
+
+	graphicsQueue = _graphicsQueue;
+	graphicsFamily = _graphicsFamily;
+	graphicsCommandPool = _graphicsCommandPool;
+
+	transferQueue = _transferQueue;
+	transferFamily = _transferFamily;
+	transferCommandPool = _transferCommandPool;
+
+	stagingBuffer = _stagingBuffer;
+	stagingMemory = _stagingMemory;
+	stagingRing.create(stagingBuffer, stagingMemory.mappedData, _stagingSize);
+
+	if (hasTransferQueue() == true)
+	{
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &transferComplete) != VK_SUCCESS)
+			throw std::runtime_error("failed to create upload semaphore!");
+	}
+}
+
+void UploadBatch::destroy()
+{
+	wait();
+
+	for (VkFence fence : freeFences)
+		vkDestroyFence(device, fence, nullptr);
+	freeFences.clear();
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	memoryAllocator->free(stagingMemory);
+	stagingBuffer = VK_NULL_HANDLE;
+
+	if (transferComplete != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(device, transferComplete, nullptr);
+		transferComplete = VK_NULL_HANDLE;
+	}
+}
+
+void UploadBatch::begin()
+{
+	if (isOpen() == true)
+		throw std::runtime_error("upload batch already open!");
+
+	reclaim(false);
+
+	if (hasTransferQueue() == true)
+	{
+		transferCommandBuffer = allocateCommandBuffer(transferCommandPool);
+		graphicsCommandBuffer = allocateCommandBuffer(graphicsCommandPool);
+	}
+	else
+	{
+		transferCommandBuffer = allocateCommandBuffer(graphicsCommandPool);
+		graphicsCommandBuffer = transferCommandBuffer;
+	}
+
+	uploadCount = 0;
+}
+
+uint32_t UploadBatch::end()
+{
+	Submission submission{};
+	submission.serial = nextSerial++;
+
+	if (freeFences.empty() == false)
+	{
+		submission.fence = freeFences.back();
+		freeFences.pop_back();
+	}
+	else
+	{
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkCreateFence(device, &fenceInfo, nullptr, &submission.fence) != VK_SUCCESS)
+			throw std::runtime_error("failed to create upload fence!");
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+	if (hasTransferQueue() == true)
+	{
+		// copies on the transfer queue, then the acquires (and mipmaps) on the graphics queue once they are done
+		vkEndCommandBuffer(transferCommandBuffer);
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &transferCommandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &transferComplete;
+
+		if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+			throw std::runtime_error("failed to submit upload batch!");
+
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &transferComplete;
+		submitInfo.pWaitDstStageMask = &waitStage;
+	}
+
+	vkEndCommandBuffer(graphicsCommandBuffer);
+
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &graphicsCommandBuffer;
+
+	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, submission.fence) != VK_SUCCESS)
+		throw std::runtime_error("failed to submit upload batch!");
+
+	// everything the batch uses stays alive until its fence signals
+	submission.transferCommandBuffer = (hasTransferQueue() == true) ? transferCommandBuffer : VK_NULL_HANDLE;
+	submission.graphicsCommandBuffer = graphicsCommandBuffer;
+	submission.releasedBuffers.swap(releasedBuffers);
+
+	stagingRing.submit(submission.serial);
+	submissions.push_back(std::move(submission));
+
+	transferCommandBuffer = VK_NULL_HANDLE;
+	graphicsCommandBuffer = VK_NULL_HANDLE;
+
+	return uploadCount;
+}
+
+void UploadBatch::wait()
+{
+	while (submissions.empty() == false)
+		reclaim(true);
+}
+
+VkCommandBuffer UploadBatch::record()
+{
+	uploadCount++;
+	return transferCommandBuffer;
+}
+
+VkCommandBuffer UploadBatch::recordGraphics()
+{
+	return graphicsCommandBuffer;
+}
+
+void* UploadBatch::allocateStaging(VkDeviceSize _size, VkBuffer& _buffer, VkDeviceSize& _offset)
+{
+	if (isOpen() == false)
+		throw std::runtime_error("staging memory outside of an upload batch!");
+
+	// the ring never allocates 0 bytes, waiting for room would loop forever
+	if (_size == 0)
+		throw std::runtime_error("staging memory for an empty upload!");
+
+	if (_size > stagingRing.getSize())
+		return nullptr;
+
+	// 16 covers the texel size and the 4 byte offset alignment of buffer to image copies
+	while (stagingRing.allocate(_size, 16, _offset) == false)
+	{
+		if (submissions.empty() == false)
+		{
+			reclaim(true);
+			continue;
+		}
+
+		// only this batch holds the ring : submit what is recorded so far and carry on in new command buffers
+		const uint32_t recordedCount = end();
+		begin();
+		uploadCount = recordedCount;
+	}
+
+	_buffer = stagingRing.getBuffer();
+	return stagingRing.getMappedData() + _offset;
+}
+
+void UploadBatch::handOverBuffer(VkBuffer _buffer, VkDeviceSize _offset, VkDeviceSize _size, VkPipelineStageFlags _dstStage, VkAccessFlags _dstAccess)
+{
+	if (isOpen() == false)
+		return;
+
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.buffer = _buffer;
+	barrier.offset = _offset;
+	barrier.size = _size;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = _dstAccess;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+	if (hasTransferQueue() == false)
+	{
+		vkCmdPipelineBarrier(transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, _dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		return;
+	}
+
+	// release : the access masks of the other queue are ignored
+	barrier.srcQueueFamilyIndex = transferFamily;
+	barrier.dstQueueFamilyIndex = graphicsFamily;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	// acquire
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = _dstAccess;
+	vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void UploadBatch::handOverImage(VkImage _image, uint32_t _mipLevels, VkImageLayout _layout, VkPipelineStageFlags _dstStage, VkAccessFlags _dstAccess)
+{
+	if (isOpen() == false)
+		return;
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = _image;
+	barrier.oldLayout = _layout;
+	barrier.newLayout = _layout;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = _dstAccess;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = _mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	if (hasTransferQueue() == false)
+	{
+		vkCmdPipelineBarrier(transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, _dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		return;
+	}
+
+	barrier.srcQueueFamilyIndex = transferFamily;
+	barrier.dstQueueFamilyIndex = graphicsFamily;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = _dstAccess;
+	vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void UploadBatch::releaseBuffer(VkBuffer _buffer, const DeviceAllocation& _memory)
+{
+	if (isOpen() == false)
+	{
+		DeviceAllocation memory = _memory;
+		vkDestroyBuffer(device, _buffer, nullptr);
+		memoryAllocator->free(memory);
+		return;
+	}
+
+	releasedBuffers.push_back({ _buffer, _memory });
+}
+
+void UploadBatch::reclaim(bool _waitForOldest)
+{
+	if (_waitForOldest == true && submissions.empty() == false)
+		vkWaitForFences(device, 1, &submissions.front().fence, VK_TRUE, UINT64_MAX);
+
+	while (submissions.empty() == false && vkGetFenceStatus(device, submissions.front().fence) == VK_SUCCESS)
+	{
+		Submission& submission = submissions.front();
+
+		vkResetFences(device, 1, &submission.fence);
+		freeFences.push_back(submission.fence);
+
+		if (submission.transferCommandBuffer != VK_NULL_HANDLE)
+			vkFreeCommandBuffers(device, transferCommandPool, 1, &submission.transferCommandBuffer);
+		vkFreeCommandBuffers(device, graphicsCommandPool, 1, &submission.graphicsCommandBuffer);
+
+		for (ReleasedBuffer& released : submission.releasedBuffers)
+		{
+			vkDestroyBuffer(device, released.buffer, nullptr);
+			memoryAllocator->free(released.memory);
+		}
+
+		stagingRing.retire(submission.serial);
+
+		submissions.pop_front();
+	}
+}
+
+VkCommandBuffer UploadBatch::allocateCommandBuffer(VkCommandPool _commandPool)
+{
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = _commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("failed to allocate upload command buffer!");
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
+}
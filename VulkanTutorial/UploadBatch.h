@@ -0,0 +1,116 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "DeviceMemoryAllocator.h"
+#include "StagingRing.h"
+
+// Records the copies and layout transitions of any number of uploads into one command buffer,
+// submitted once with a fence instead of a submit and a queue idle per copy.
+//
+// With a dedicated transfer queue the copies run there, beside rendering. Every uploaded resource is then
+// handed over to the graphics queue family : a release barrier at the end of the transfer commands and
+// the matching acquire barrier in a graphics command buffer, submitted after the transfer one and waiting
+// on its semaphore. Graphics-only work (mipmap blits) goes into that graphics command buffer too.
+//
+// end() doesn't wait : later graphics submissions are ordered after the batch on the queue anyway.
+// Staging memory comes from a StagingRing, its regions, the command buffers and the staging buffers handed
+// to releaseBuffer() are recycled once the batch's fence has signalled.
+class UploadBatch
+{
+public:
+	// _transferQueue : VK_NULL_HANDLE to record everything for _graphicsQueue
+	// _stagingBuffer / _stagingMemory : host visible and coherent, owned by the batch from now on
+	// and freed, like the buffers handed to releaseBuffer(), through _memoryAllocator
+	void create(VkDevice _device, VkQueue _graphicsQueue, uint32_t _graphicsFamily, VkCommandPool _graphicsCommandPool,
+		VkQueue _transferQueue, uint32_t _transferFamily, VkCommandPool _transferCommandPool,
+		DeviceMemoryAllocator* _memoryAllocator, VkBuffer _stagingBuffer, const DeviceAllocation& _stagingMemory, VkDeviceSize _stagingSize);
+	void destroy();
+
+	void begin();
+
+	// submits everything recorded since begin(), returns the number of recorded uploads
+	uint32_t end();
+
+	// blocks until every submitted batch has completed
+	void wait();
+
+	bool isOpen() const { return transferCommandBuffer != VK_NULL_HANDLE; }
+
+	bool hasTransferQueue() const { return transferQueue != VK_NULL_HANDLE; }
+
+	// the batch's transfer command buffer, counts one recorded upload
+	VkCommandBuffer record();
+
+	// the batch's graphics command buffer, recorded after the acquire barriers of the resources handed over so far
+	VkCommandBuffer recordGraphics();
+
+	// _size bytes of staging memory in _buffer at _offset, to copy from in this batch.
+	// Waits for earlier batches when the ring is full, and submits the commands recorded so far
+	// when this batch alone fills it. nullptr if _size is larger than the whole ring, throws if _size is 0.
+	void* allocateStaging(VkDeviceSize _size, VkBuffer& _buffer, VkDeviceSize& _offset);
+
+	// makes the transfer writes to a buffer range / an image (in _layout) visible to _dstStage / _dstAccess on the graphics queue,
+	// a queue family ownership transfer with a dedicated transfer queue and a plain barrier otherwise
+	void handOverBuffer(VkBuffer _buffer, VkDeviceSize _offset, VkDeviceSize _size, VkPipelineStageFlags _dstStage, VkAccessFlags _dstAccess);
+	void handOverImage(VkImage _image, uint32_t _mipLevels, VkImageLayout _layout, VkPipelineStageFlags _dstStage, VkAccessFlags _dstAccess);
+
+	// destroyed once the batch has completed, or right away when no batch is open
+	void releaseBuffer(VkBuffer _buffer, const DeviceAllocation& _memory);
+
+	const StagingRing& getStagingRing() const { return stagingRing; }
+
+private:
+	VkCommandBuffer allocateCommandBuffer(VkCommandPool _commandPool);
+
+	// recycles the batches whose fence has signalled, or waits for the oldest one first
+	void reclaim(bool _waitForOldest);
+
+private:
+	struct ReleasedBuffer
+	{
+		VkBuffer buffer;
+		DeviceAllocation memory;
+	};
+
+	struct Submission
+	{
+		uint64_t serial;
+		VkFence fence;
+		VkCommandBuffer transferCommandBuffer; // VK_NULL_HANDLE without a transfer queue
+		VkCommandBuffer graphicsCommandBuffer;
+		std::vector<ReleasedBuffer> releasedBuffers;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+
+	VkQueue graphicsQueue = VK_NULL_HANDLE;
+	uint32_t graphicsFamily = 0;
+	VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	uint32_t transferFamily = 0;
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+
+	VkSemaphore transferComplete = VK_NULL_HANDLE;
+
+	DeviceMemoryAllocator* memoryAllocator = nullptr;
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	DeviceAllocation stagingMemory;
+	StagingRing stagingRing;
+
+	// the same command buffer without a transfer queue
+	VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+	VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+
+	std::vector<ReleasedBuffer> releasedBuffers;
+	uint32_t uploadCount = 0;
+
+	uint64_t nextSerial = 1;
+	std::deque<Submission> submissions; // oldest first
+	std::vector<VkFence> freeFences;
+};
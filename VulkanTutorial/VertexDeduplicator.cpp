@@ -0,0 +1,57 @@
+﻿#include "VertexDeduplicator.h"
+
+#include <algorithm>
+
+namespace
+{
+	size_t slotCountFor(size_t _vertexCount)
+	{
+		size_t slotCount = 16;
+		while (slotCount < _vertexCount * 2)
+			slotCount *= 2;
+
+		return slotCount;
+	}
+}
+
+VertexDeduplicator::VertexDeduplicator(std::vector<Vertex>& _vertices, size_t _expectedVertexCount)
+	: vertices(_vertices)
+{
+	reserve(std::max(_expectedVertexCount, vertices.size()));
+}
+
+void VertexDeduplicator::reserve(size_t _vertexCount)
+{
+	const size_t slotCount = slotCountFor(_vertexCount);
+	if (slotCount <= slots.size())
+		return;
+
+	vertices.reserve(_vertexCount);
+
+	slots.assign(slotCount, Slot{ 0, EMPTY_SLOT });
+	mask = slotCount - 1;
+
+	// re-insert whatever is already in the vertex array (the table only ever holds indices into it)
+	for (uint32_t i = 0; i < static_cast<uint32_t>(vertices.size()); i++)
+	{
+		const uint64_t hash = hashVertex(vertices[i]);
+
+		size_t slot = static_cast<size_t>(hash) & mask;
+		while (slots[slot].index != EMPTY_SLOT)
+			slot = (slot + 1) & mask;
+
+		slots[slot].tag = static_cast<uint32_t>(hash >> 32);
+		slots[slot].index = i;
+	}
+}
+
+void VertexDeduplicator::grow()
+{
+	reserve(std::max<size_t>(slots.size(), 8));
+}
+
+IndexDeduplicator::IndexDeduplicator(size_t _positionCount, size_t _expectedKeyCount)
+	: buckets(_positionCount, EMPTY_ENTRY)
+{
+	entries.reserve(_expectedKeyCount);
+}
@@ -0,0 +1,138 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+#include "Hash.h"
+#include "Vertex.h"
+
+// Maps each distinct Vertex to its index in a vertex array, appending vertices the first time they are seen.
+//
+// Flat open-addressing table (linear probing, power of two capacity, load factor <= 1/2).
+// Vertices are compared and hashed on their raw bits, so one lookup-or-insert per corner
+// costs a single probe sequence and never allocates unless the table has to grow.
+class VertexDeduplicator
+{
+public:
+	// _expectedVertexCount : number of unique vertices to reserve room for, the table grows past it if needed
+	explicit VertexDeduplicator(std::vector<Vertex>& _vertices, size_t _expectedVertexCount = 0);
+
+	void reserve(size_t _vertexCount);
+
+	// Returns the index of _vertex in the vertex array, appending it if it hasn't been seen yet.
+	uint32_t insert(const Vertex& _vertex)
+	{
+		if ((vertices.size() + 1) * 2 > slots.size())
+			grow();
+
+		const uint64_t hash = hashVertex(_vertex);
+		const uint32_t tag = static_cast<uint32_t>(hash >> 32);
+
+		for (size_t slot = static_cast<size_t>(hash) & mask;; slot = (slot + 1) & mask)
+		{
+			Slot& entry = slots[slot];
+
+			if (entry.index == EMPTY_SLOT)
+			{
+				entry.tag = tag;
+				entry.index = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(_vertex);
+				return entry.index;
+			}
+
+			if (entry.tag == tag && memcmp(&vertices[entry.index], &_vertex, sizeof(Vertex)) == 0)
+				return entry.index;
+		}
+	}
+
+	static uint64_t hashVertex(const Vertex& _vertex)
+	{
+		static_assert(sizeof(Vertex) == 4 * sizeof(uint64_t), "hashVertex expects a tightly packed 32 byte Vertex");
+
+		uint64_t words[4];
+		memcpy(words, &_vertex, sizeof(words));
+
+		// two independent lanes, then one final mix
+		const uint64_t prime = 0x9e3779b97f4a7c15ULL;
+		uint64_t low = hashMix64(words[0] ^ (words[1] * prime));
+		uint64_t high = hashMix64(words[2] ^ (words[3] * prime));
+
+		return low ^ ((high << 29) | (high >> 35));
+	}
+
+private:
+	static const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+	struct Slot
+	{
+		uint32_t tag; // upper hash bits, skips most vertex compares on collisions
+		uint32_t index;
+	};
+
+	void grow();
+
+	std::vector<Vertex>& vertices;
+
+	std::vector<Slot> slots;
+	size_t mask = 0;
+};
+
+// Maps each distinct OBJ index pair (vertex_index, texcoord_index) to a sequential key id.
+//
+// Corners that share their indices always produce the same Vertex, so deduplicating in index space
+// means the Vertex only has to be built and hashed for keys seen for the first time.
+// normal_index isn't part of the key since Vertex has no normal, keying on it would only split vertices.
+// vertex_index is dense, so it indexes a bucket array directly and no hashing is needed at all :
+// each bucket is a short chain of the texcoord indices seen with that position (usually one, more on uv seams).
+// Distinct indices can still reference equal values (exporters often write them per face),
+// so new keys are meant to be passed on to a VertexDeduplicator.
+class IndexDeduplicator
+{
+public:
+	// _positionCount : number of positions in the attrib_t the indices refer to
+	IndexDeduplicator(size_t _positionCount, size_t _expectedKeyCount);
+
+	size_t size() const { return entries.size(); }
+
+	// Returns the key id of _index. _isNew is true if the key hasn't been seen yet.
+	// Throws if _index.vertex_index isn't one of the _positionCount positions.
+	uint32_t insert(const tinyobj::index_t& _index, bool& _isNew)
+	{
+		// a negative index wraps around to a huge one
+		const size_t position = static_cast<size_t>(_index.vertex_index);
+		if (position >= buckets.size())
+			throw std::runtime_error("obj face references a position that doesn't exist!");
+
+		uint32_t& bucket = buckets[position];
+
+		for (uint32_t entry = bucket; entry != EMPTY_ENTRY; entry = entries[entry].next)
+		{
+			if (entries[entry].texcoordIndex == _index.texcoord_index)
+			{
+				_isNew = false;
+				return entry;
+			}
+		}
+
+		entries.push_back(Entry{ _index.texcoord_index, bucket });
+		bucket = static_cast<uint32_t>(entries.size() - 1);
+
+		_isNew = true;
+		return bucket;
+	}
+
+private:
+	static const uint32_t EMPTY_ENTRY = UINT32_MAX;
+
+	struct Entry
+	{
+		int texcoordIndex;
+		uint32_t next; // next key with the same vertex_index
+	};
+
+	std::vector<uint32_t> buckets; // vertex_index -> most recent key with it
+	std::vector<Entry> entries; // key id -> entry
+};
@@ -0,0 +1,81 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Deinterleaved layout of an interleaved vertex type (Vertex, CompactVertex) :
+//	binding 0	- positions only
+//	binding 1	- every other attribute, in the interleaved order
+// so position-only passes (depth prepass, shadows) bind just binding 0 and fetch only the position bytes.
+// Both streams can live in one buffer, the attribute stream starting after all positions.
+template<typename VertexType>
+struct VertexStreams
+{
+	static constexpr uint32_t POSITION_SIZE = sizeof(VertexType::pos);
+	static constexpr uint32_t ATTRIBUTE_SIZE = sizeof(VertexType) - POSITION_SIZE;
+
+	static std::array<VkVertexInputBindingDescription, 2> getBindingDescriptions()
+	{
+		std::array<VkVertexInputBindingDescription, 2> bindingDescriptions{};
+		bindingDescriptions[0] = getPositionBindingDescription();
+
+		bindingDescriptions[1].binding = 1;
+		bindingDescriptions[1].stride = ATTRIBUTE_SIZE;
+		bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescriptions;
+	}
+
+	// same locations and formats as VertexType::getAttributeDescriptions(), moved to their stream
+	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
+	{
+		auto attributeDescriptions = VertexType::getAttributeDescriptions();
+
+		for (auto& attributeDescription : attributeDescriptions)
+		{
+			if (attributeDescription.offset < POSITION_SIZE)
+				continue;
+
+			attributeDescription.binding = 1;
+			attributeDescription.offset -= POSITION_SIZE;
+		}
+
+		return attributeDescriptions;
+	}
+
+	// vertex input of a position-only pipeline
+	static VkVertexInputBindingDescription getPositionBindingDescription()
+	{
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = POSITION_SIZE;
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	static VkVertexInputAttributeDescription getPositionAttributeDescription()
+	{
+		return VertexType::getAttributeDescriptions()[0];
+	}
+
+	// _positions : _vertexCount * POSITION_SIZE bytes, _attributes : _vertexCount * ATTRIBUTE_SIZE bytes
+	static void split(const VertexType* _vertices, size_t _vertexCount, void* _positions, void* _attributes)
+	{
+		static_assert(offsetof(VertexType, pos) == 0, "the position must be the first attribute of the vertex");
+
+		char* positions = static_cast<char*>(_positions);
+		char* attributes = static_cast<char*>(_attributes);
+
+		for (size_t i = 0; i < _vertexCount; i++)
+		{
+			const char* vertex = reinterpret_cast<const char*>(&_vertices[i]);
+
+			memcpy(positions + i * POSITION_SIZE, vertex, POSITION_SIZE);
+			memcpy(attributes + i * ATTRIBUTE_SIZE, vertex + POSITION_SIZE, ATTRIBUTE_SIZE);
+		}
+	}
+};
@@ -1,15 +1,37 @@
 ﻿#include <iostream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
+#include "Benchmarks.h"
 #include "HelloTriangleApplication.h"
 
-int main() 
+int main(int argc, char** argv) 
 {
+	// VulkanTutorial.exe --bench <name> [args...]
+	if (argc >= 3 && std::string(argv[1]) == "--bench")
+	{
+		try
+		{
+			std::vector<std::string> args(argv + 3, argv + argc);
+			return RunBenchmark(argv[2], args) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
 	HelloTriangleApplication app;
 
 	try 
 	{
-		app.Run();
+		// VulkanTutorial.exe --frame-bench [frames per setting] [draws per frame]
+		if (argc >= 2 && std::string(argv[1]) == "--frame-bench")
+			app.RunFrameBenchmark((argc >= 3) ? static_cast<uint32_t>(std::stoul(argv[2])) : 1000, (argc >= 4) ? static_cast<uint32_t>(std::stoul(argv[3])) : 1);
+		else
+			app.Run();
 	}
 	catch (const std::exception& e) 
 	{
@@ -1,3 +1,6 @@
 C:/VulkanSDK/1.2.182.0/Bin32/glslc.exe shader.vert -o vert.spv
+C:/VulkanSDK/1.2.182.0/Bin32/glslc.exe shader_instanced.vert -o instanced_vert.spv
 C:/VulkanSDK/1.2.182.0/Bin32/glslc.exe shader.frag -o frag.spv
+C:/VulkanSDK/1.2.182.0/Bin32/glslc.exe meshlet_cull.comp -o meshlet_cull.spv
+C:/VulkanSDK/1.2.182.0/Bin32/glslc.exe instance_cull.comp -o instance_cull.spv
 pause
\ No newline at end of file
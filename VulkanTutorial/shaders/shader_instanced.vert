@@ -0,0 +1,37 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject
+{
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+// InstanceData
+layout(location = 3) in vec4 inInstancePositionScale;
+layout(location = 4) in vec4 inInstanceRotation;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main() 
+{
+	// ubo.model places (and dequantizes) the model, the instance transform places the copy
+	vec3 modelPosition = (ubo.model * vec4(inPosition, 1.0)).xyz;
+	vec3 worldPosition = rotate(inInstanceRotation, modelPosition) * inInstancePositionScale.w + inInstancePositionScale.xyz;
+
+	gl_Position = ubo.proj * ubo.view * vec4(worldPosition, 1.0);
+	
+	fragColor = inColor;
+
+	fragTexCoord = inTexCoord;
+}